@@ -28,7 +28,9 @@ let package = Package(
             path: ".",
             sources: [
                 "src/html2md.cpp",
+                "src/html2md_c.cpp",
                 "src/table.cpp",
+                "src/trace.cpp",
             ],
             publicHeadersPath: "include",
             cxxSettings: [
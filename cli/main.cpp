@@ -1,7 +1,14 @@
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
 #include <fstream>
+#include <iomanip>
 #include <iostream>
 #include <sstream>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "html2md.h"
 
@@ -61,12 +68,19 @@ constexpr const char *const DESCRIPTION =
     "asking.\n";
 
   constexpr const char *const EXTRA_OPTIONS =
-    "  -E, --preserve-entities\tKeep HTML entities (e.g. &nbsp;) in output.\n";
+    "  -E, --preserve-entities\tKeep HTML entities (e.g. &nbsp;) in output.\n"
+    "  -e, --escape-markdown\tEscape all text Markdown would read as markup.\n"
+    "  -s, --stats\tPrint conversion statistics to stderr.\n"
+    "  -j, --threads\tThreads used to convert large documents (0: one per "
+    "core).\n";
 
 struct Options {
   bool print = false;
   bool replace = false;
   bool preserveEntities = false;
+  bool escapeMarkdown = false;
+  bool stats = false;
+  unsigned threads = 1;
   string inputFile;
   string outputFile;
   string inputText;
@@ -121,6 +135,23 @@ Options parseCommandLine(int argc, char **argv) {
       options.replace = true;
     } else if (arg == "-E" || arg == "--preserve-entities") {
       options.preserveEntities = true;
+    } else if (arg == "-e" || arg == "--escape-markdown") {
+      options.escapeMarkdown = true;
+    } else if (arg == "-s" || arg == "--stats") {
+      options.stats = true;
+    } else if (arg == "-j" || arg == "--threads") {
+      // strtoul() would accept a sign and leading whitespace
+      const char *number = i + 1 < argc ? argv[i + 1] : "";
+      char *end = nullptr;
+      errno = 0;
+      const unsigned long threads = std::strtoul(number, &end, 10);
+      if (*number < '0' || *number > '9' || *end != '\0' || errno != 0 ||
+          threads > UINT_MAX) {
+        cerr << "The " << arg << " option requires a number!" << endl;
+        exit(EXIT_FAILURE);
+      }
+      options.threads = static_cast<unsigned>(threads);
+      i++;
     } else if (arg == "-o" || arg == "--output") {
       if (i + 1 < argc) {
         options.outputFile = argv[i + 1];
@@ -145,6 +176,43 @@ Options parseCommandLine(int argc, char **argv) {
   return options;
 }
 
+void printStats(const html2md::ConversionStats &stats) {
+  auto ms = [](uint64_t ns) { return ns / 1e6; };
+
+  cerr << "Input:              " << stats.inputBytes << " bytes\n"
+       << "Output:             " << stats.outputBytes << " bytes (estimated "
+       << stats.estimatedOutputBytes << ")\n"
+       << "Ignored:            " << stats.ignoredBytes << " bytes\n"
+       << "Entities decoded:   " << stats.entitiesDecoded << "\n"
+       << "Tables formatted:   " << stats.tablesFormatted << " ("
+       << stats.tableCells << " cells)\n"
+       << "Reallocations:      " << stats.reallocations << "\n";
+
+  cerr << std::fixed << std::setprecision(3)
+       << "Time:               " << ms(stats.totalNs) << " ms\n"
+       << "  tokenize          " << ms(stats.tokenizeNs) << " ms\n"
+       << "  format tables     " << ms(stats.tableNs) << " ms\n"
+       << "  tidy lines        " << ms(stats.tidyNs) << " ms\n"
+       << "  decode entities   " << ms(stats.entitiesNs) << " ms\n"
+       << "  replace           " << ms(stats.replaceNs) << " ms\n"
+       << "  wrap lines        " << ms(stats.wrapNs) << " ms\n";
+
+  // Most frequent tags first
+  std::vector<std::pair<string, size_t>> tags(stats.tags.begin(),
+                                              stats.tags.end());
+  std::sort(tags.begin(), tags.end(),
+            [](const std::pair<string, size_t> &a,
+               const std::pair<string, size_t> &b) {
+              return a.second != b.second ? a.second > b.second
+                                          : a.first < b.first;
+            });
+
+  cerr << "Tags:\n";
+  for (const auto &tag : tags)
+    cerr << "  " << std::left << std::setw(18) << tag.first << tag.second
+         << "\n";
+}
+
 int main(int argc, char **argv) {
   Options options = parseCommandLine(argc, argv);
 
@@ -162,8 +230,15 @@ int main(int argc, char **argv) {
   // Pass CLI-driven option to the converter
   html2md::Options copt;
   copt.keepHtmlEntities = options.preserveEntities;
+  copt.escapeMarkdown = options.escapeMarkdown;
+  copt.threads = options.threads;
   html2md::Converter converter(input, &copt);
-  string md = converter.convert();
+  html2md::ConversionStats stats;
+  string md = converter.convert(options.stats ? &stats : nullptr);
+
+  if (options.stats) {
+    printStats(stats);
+  }
 
   if (options.print) {
     cout << md << endl;
@@ -7,6 +7,7 @@
 #include <memory>
 #include <string>
 #include <unordered_map>
+#include <utility>
 #include <cstdint>
 
 /*!
@@ -38,7 +39,11 @@ namespace html2md {
  */
 struct Options {
   /*!
-   * \brief Add new line when a certain number of characters is reached
+   * \brief Wrap long lines of the generated Markdown
+   *
+   * Lines are measured in display columns (CJK characters take two). Code
+   * blocks, tables, headings, links and inline code are never broken, and
+   * continuation lines keep the list indentation and blockquote markers.
    *
    * \see softBreak
    * \see hardBreak
@@ -46,13 +51,13 @@ struct Options {
   bool splitLines = true;
 
   /*!
-   * \brief softBreak Wrap after ...  characters when the next space is reached
-   * and as long as it's not in a list, table, image or anchor (link).
+   * \brief softBreak Wrap at the next space once a line is ... columns wide
    */
   int softBreak = 80;
 
   /*!
-   * \brief hardBreak Force a break after ... characters in a line
+   * \brief hardBreak Wrap at the previous space once a line is wider than ...
+   * columns
    */
   int hardBreak = 100;
 
@@ -120,6 +125,8 @@ struct Options {
    * space
    *
    * Whether to compress whitespace (tabs, multiple spaces) into a single space.
+   * Like in a browser, a newline in the text counts as whitespace too and there
+   * is no space at the start of a line. Text in `<pre>` is left as it is.
    * Default is false.
    */
   bool compressWhitespace = false;
@@ -133,6 +140,17 @@ struct Options {
    */
   bool escapeNumberedList = true;
 
+  /*!
+   * \brief Whether to escape all text that Markdown would read as markup
+   *
+   * Besides `*`, `` ` ``, `\` and numbered lists, `_`, `[`, `]` and `<` (from
+   * `&lt;`) are escaped everywhere, `|` in tables and `#`, `-`, `+` and
+   * `>` (also from `&gt;`) at the start of a line. Text in code is never
+   * escaped.
+   * Default is false.
+   */
+  bool escapeMarkdown = false;
+
   /*!
    * \brief Whether to keep HTML entities (e.g. `&nbsp;`) in the output
    *
@@ -141,6 +159,19 @@ struct Options {
    */
   bool keepHtmlEntities = false;
 
+  /*!
+   * \brief Threads used to convert large documents
+   *
+   * HTML of more than 512 KB is cut after the end of block elements (`</p>`,
+   * `</div>`, `</table>`, ...) into parts which are converted concurrently,
+   * and the Markdown of several MB is cleaned up in parts as well. The output
+   * is the same as with a single thread: a part whose conversion could depend
+   * on the HTML before it is converted again after it. 0 uses one thread per
+   * core.
+   * Default is 1.
+   */
+  unsigned threads = 1;
+
   inline bool operator==(html2md::Options o) const {
     return splitLines == o.splitLines && unorderedList == o.unorderedList &&
            orderedList == o.orderedList && includeTitle == o.includeTitle &&
@@ -148,10 +179,118 @@ struct Options {
            formatTable == o.formatTable && forceLeftTrim == o.forceLeftTrim &&
            compressWhitespace == o.compressWhitespace &&
            escapeNumberedList == o.escapeNumberedList &&
-           keepHtmlEntities == o.keepHtmlEntities;
+           escapeMarkdown == o.escapeMarkdown &&
+           keepHtmlEntities == o.keepHtmlEntities && threads == o.threads;
   };
 };
 
+/*!
+ * \brief Statistics about a single conversion
+ *
+ * Filled by Converter::convert(ConversionStats *). Useful to find out why a
+ * document is slow to convert or how much memory it needs.
+ * All times are wall-clock times in nanoseconds.
+ *
+ * ```cpp
+ * html2md::ConversionStats stats;
+ * html2md::Converter c(html);
+ * auto md = c.convert(&stats);
+ * std::cout << stats.estimatedOutputBytes << " vs " << stats.outputBytes;
+ * ```
+ */
+struct ConversionStats {
+  /*!
+   * \brief Size of the HTML input in bytes
+   */
+  size_t inputBytes = 0;
+
+  /*!
+   * \brief Size of the generated Markdown in bytes
+   */
+  size_t outputBytes = 0;
+
+  /*!
+   * \brief Size of the Markdown as predicted before the conversion
+   *
+   * The output buffer is reserved with this size. It is derived from a quick
+   * scan of the input that counts text, markup and ignored elements like
+   * `<script>`. Compare it with outputBytes to tune the estimate.
+   */
+  size_t estimatedOutputBytes = 0;
+
+  /*!
+   * \brief Number of opening tags seen, by tag name (lowercase)
+   *
+   * Contains unknown tags too, e.g. `tbody` or custom elements.
+   */
+  std::unordered_map<std::string, size_t> tags;
+
+  /*!
+   * \brief Bytes of text dropped because they were inside an ignored tag
+   * like `<script>` or `<style>`
+   */
+  size_t ignoredBytes = 0;
+
+  /*!
+   * \brief Number of HTML entities (e.g. `&amp;`) that were replaced
+   */
+  size_t entitiesDecoded = 0;
+
+  /*!
+   * \brief Number of tables that were formatted (see Options::formatTable)
+   */
+  size_t tablesFormatted = 0;
+
+  /*!
+   * \brief Number of table cells (`th` and `td`) seen
+   */
+  size_t tableCells = 0;
+
+  /*!
+   * \brief How often the Markdown buffer had to be reallocated
+   *
+   * Growing while the HTML is parsed counts once, however often it grew.
+   */
+  size_t reallocations = 0;
+
+  /*!
+   * \brief Time spent parsing the HTML, excluding table formatting
+   */
+  uint64_t tokenizeNs = 0;
+
+  /*!
+   * \brief Time spent trimming lines and removing redundant blank lines
+   */
+  uint64_t tidyNs = 0;
+
+  /*!
+   * \brief Time spent replacing HTML entities
+   */
+  uint64_t entitiesNs = 0;
+
+  /*!
+   * \brief Time spent in the final search-and-replace clean up
+   */
+  uint64_t replaceNs = 0;
+
+  /*!
+   * \brief Time spent formatting tables
+   *
+   * With Options::threads the time of all threads is added up.
+   */
+  uint64_t tableNs = 0;
+
+  /*!
+   * \brief Time spent wrapping long lines (see Options::splitLines)
+   */
+  uint64_t wrapNs = 0;
+
+  /*!
+   * \brief Total time of the conversion
+   */
+  uint64_t totalNs = 0;
+};
+
 /*!
  * \brief Class for converting HTML to Markdown
  *
@@ -210,9 +349,8 @@ public:
    * generated output.
    */
   explicit inline Converter(const std::string &html,
-                            struct Options *options = nullptr) {
-    *this = Converter(&html, options);
-  }
+                            struct Options *options = nullptr)
+      : Converter(&html, options) {}
 
   /*!
    * \brief Convert HTML into Markdown.
@@ -223,6 +361,60 @@ public:
    */
   [[nodiscard]] std::string convert();
 
+  /*!
+   * \brief Convert HTML into Markdown and collect statistics.
+   * \param stats Filled with statistics about the conversion, may be nullptr.
+   * \return Returns the converted Markdown.
+   *
+   * Collecting the statistics costs a little time, so use convert() if you
+   * don't need them.
+   *
+   * \note Only the call that actually converts fills the counters and times.
+   * Later calls return the cached Markdown and only update the sizes.
+   */
+  [[nodiscard]] std::string convert(ConversionStats *stats);
+
+  /*!
+   * \brief Convert more HTML, e.g. the next chunk of a download.
+   * \param data The next part of the HTML. It may end anywhere, even within a
+   * tag or a UTF-8 sequence.
+   * \param size Length of data in bytes.
+   *
+   * The chunks are converted as they arrive and not kept, so the HTML never
+   * has to be in memory as a whole. The HTML passed to the constructor comes
+   * first. Call finish() after the last chunk to get the Markdown, which is
+   * the same as convert() returns for all of the HTML at once.
+   *
+   * \note Options::threads has no effect here.
+   */
+  void feed(const char *data, size_t size);
+
+  /*!
+   * \brief Take the Markdown of the HTML fed so far that can't change anymore.
+   * \return Returns the final Markdown, which is removed from the Converter.
+   *
+   * The Markdown is final up to the start of a paragraph that follows a blank
+   * line and is followed by another paragraph, outside of tables and code
+   * blocks. It's cleaned up like finish() does. Together with the Markdown of
+   * later calls and of finish() it is the same as convert() returns for all
+   * of the HTML, so only the unfinished end of the Markdown has to be kept.
+   *
+   * Returns an empty string if nothing is final yet, if feed() wasn't called
+   * or if a symbol conversion could match across lines.
+   */
+  [[nodiscard]] std::string flush();
+
+  /*!
+   * \brief Finish a conversion started with feed().
+   * \return Returns the Markdown of all the HTML, without what flush()
+   * returned.
+   *
+   * Without a call to feed() this is the same as convert(). Otherwise the
+   * Markdown is moved out instead of copied, and the next feed() starts a new
+   * conversion.
+   */
+  [[nodiscard]] std::string finish();
+
   /*!
    * \brief Append a char to the Markdown.
    * \param ch The char to append.
@@ -243,9 +435,17 @@ public:
    * \return Returns a copy of the instance with the string appended.
    */
   inline Converter *appendToMd(const std::string &s) {
-    return appendToMd(s.c_str());
+    return appendToMd(s.data(), s.size());
   }
 
+  /*!
+   * \brief Append chars to the Markdown.
+   * \param str The chars to append.
+   * \param size The number of chars.
+   * \return Returns a copy of the instance with the chars appended.
+   */
+  Converter *appendToMd(const char *str, size_t size);
+
   /*!
    * \brief Appends a ' ' in certain cases.
    * \return Copy of the instance with(maybe) the appended space.
@@ -378,8 +578,17 @@ private:
 
   size_t index_ch_in_html_ = 0;
 
+  // Where the tokenizer is: in text, or where in a tag
+  enum class TokenizerState : uint8_t {
+    kText,
+    kTagStart, // After '<' or '/', whitespace is skipped
+    kTag,
+    kDoubleQuotedValue,
+    kSingleQuotedValue,
+  };
+  TokenizerState tokenizer_state_ = TokenizerState::kText;
+
   bool is_closing_tag_ = false;
-  bool is_in_attribute_value_ = false;
   bool is_in_code_ = false;
   bool is_in_list_ = false;
   bool is_in_p_ = false;
@@ -389,6 +598,9 @@ private:
   bool is_in_tag_ = false;
   bool is_self_closing_tag_ = false;
 
+  // Text is neither code nor ignored, so most chars are copied as they are
+  bool is_plain_text_ = true;
+
   // relevant for <li> only, false = is in unordered list
   bool is_in_ordered_list_ = false;
   uint8_t index_ol = 0;
@@ -396,6 +608,9 @@ private:
   // store the table start
   size_t table_start = 0;
 
+  // number of tables, nested tables are formatted as one
+  uint8_t index_table = 0;
+
   // number of lists
   uint8_t index_li = 0;
 
@@ -406,17 +621,52 @@ private:
 
   std::string html_;
 
-  uint16_t offset_lt_ = 0;
+  // Everything after the '<' of the current tag, including the '>'
+  std::string raw_tag_;
   std::string current_tag_;
   std::string prev_tag_;
 
   // Line which separates header from data
   std::string tableLine;
 
+  // Attributes of the <a> tag currently open
+  std::string current_href_;
+  std::string current_title_;
+
   size_t chars_in_curr_line_ = 0;
 
+  // feed() was called and finish() not yet
+  bool is_fed_ = false;
+
+  // flush() looked at the lines of md_ before this offset for a place to cut,
+  // flush_in_code_ is whether a code block is open there
+  size_t flush_scanned_ = 0;
+  bool flush_in_code_ = false;
+
+  // ReplacePreviousSpaceInLineByNewline() found no space before this offset
+  size_t no_space_end_ = 0;
+
+  // Lowest offset of md_ that was read back or cut off since it was last set.
+  // Lets TokenizeInParallel() see whether a part depends on Markdown before
+  // its start.
+  size_t md_low_water_ = 0;
+
+  // End of the last text written to md_, markup written after it doesn't
+  // count for IsAtLineStart()
+  size_t last_text_end_ = 0;
+
+  // Offset of the last '&' of the text that was written at the start of a
+  // line, see IsAtLineStart()
+  size_t line_start_amp_ = std::string::npos;
+
   std::string md_;
 
+  // Output size predicted by the pre-scan of the HTML
+  size_t estimated_md_size_ = 0;
+
+  // Only set while convert(ConversionStats *) is running
+  ConversionStats *stats_ = nullptr;
+
   Options option;
 
   std::unordered_map<std::string, std::string> htmlSymbolConversions_ = {
@@ -440,9 +690,6 @@ private:
   struct TagAnchor : Tag {
     void OnHasLeftOpeningTag(Converter *c) override;
     void OnHasLeftClosingTag(Converter *c) override;
-
-    std::string current_href_;
-    std::string current_title_;
   };
 
   struct TagBold : Tag {
@@ -585,12 +832,37 @@ private:
     void OnHasLeftClosingTag(Converter *c) override;
   };
 
-  std::unordered_map<std::string, std::shared_ptr<Tag>> tags_;
+  // Tag handlers are stateless, so one table is shared by all instances.
+  // Building it per Converter dominated the cost of converting small inputs.
+  using TagMap = std::unordered_map<std::string, std::shared_ptr<Tag>>;
+  static const TagMap &Tags();
 
   explicit Converter(const std::string *html, struct Options *options);
 
+  // Fill md_ without copying it out (see convert())
+  void ConvertHtml();
+
+  friend std::string Convert(const std::string &html, bool *ok);
+
   void CleanUpMarkdown();
 
+  // Whether no symbol conversion can match across the start of a line that
+  // begins with an ASCII letter or digit, so the Markdown can be cleaned up
+  // in parts cut there
+  bool SymbolsStayWithinLines() const;
+
+  // Does the work of CleanUpMarkdown() except wrapping on several threads.
+  // Returns false if the Markdown is too small or can't be cut into parts.
+  bool CleanUpMarkdownInParallel();
+
+  // Tokenize the whole HTML on several threads. Returns false if the HTML is
+  // too small or can't be cut into parts.
+  bool TokenizeInParallel();
+
+  // Whether the conversion of more HTML would continue the same way as in
+  // other, given that md_ ends with other.md_
+  [[nodiscard]] bool HasSameStateAs(const Converter &other) const;
+
   // Trim from start (in place)
   static void LTrim(std::string *s);
 
@@ -600,10 +872,6 @@ private:
   // Trim from both ends (in place)
   Converter *Trim(std::string *s);
 
-  // 1. trim all lines
-  // 2. reduce consecutive newlines to maximum 3
-  void TidyAllLines(std::string *str);
-
   std::string ExtractAttributeFromTagLeftOf(const std::string &attr);
 
   void TurnLineIntoHeader1();
@@ -613,15 +881,18 @@ private:
   // Current char: '<'
   void OnHasEnteredTag();
 
+  // Run the tokenizer over the next chunk of the HTML
+  void Tokenize(const char *data, size_t size);
+
+  // Tokenize() with compressWhitespace as template parameter, so it costs
+  // nothing in the loop when disabled
+  template <bool kCompressWhitespace>
+  void TokenizeWith(const char *data, size_t size);
+
   Converter *UpdatePrevChFromMd();
 
-  /**
-   * Handle next char within <...> tag
-   *
-   * @param ch current character
-   * @return   continue surrounding iteration?
-   */
-  bool ParseCharInTag(char ch);
+  // Handle next char within <...> tag
+  void ParseCharInTag(char ch);
 
   // Current char: '>'
   bool OnHasLeftTag();
@@ -649,7 +920,11 @@ private:
    * @param ch
    * @return continue iteration surrounding  this method's invocation?
    */
-  bool ParseCharInTagContent(char ch);
+  template <bool kCompressWhitespace> bool ParseCharInTagContent(char ch);
+
+  // Is there only markup and whitespace between the last newline and the end
+  // of md_? Then a '#', '-', '+' or '>' would start a block.
+  bool IsAtLineStart();
 
   // Replace previous space (if any) in current markdown line by newline
   bool ReplacePreviousSpaceInLineByNewline();
@@ -672,10 +947,11 @@ private:
  */
 inline std::string Convert(const std::string &html, bool *ok = nullptr) {
   Converter c(html);
-  auto md = c.convert();
+  c.ConvertHtml();
   if (ok != nullptr)
     *ok = c.ok();
-  return md;
+  // The converter is discarded, so hand out its buffer instead of a copy
+  return std::move(c.md_);
 }
 
 #ifndef PYTHON_BINDINGS
@@ -0,0 +1,206 @@
+// Copyright (c) Tim Gromeyer
+// Licensed under the MIT License - https://opensource.org/licenses/MIT
+
+#ifndef HTML2MD_C_H
+#define HTML2MD_C_H
+
+/*!
+ * \file html2md_c.h
+ * \brief C interface of html2md, for use from other languages
+ *
+ * An engine holds the options and the result of the last conversion. The
+ * Markdown is copied into a buffer of the caller, or borrowed from the engine
+ * with html2md_output() without a copy. No C++ exception leaves these
+ * functions; errors are reported by the returned status.
+ *
+ * ```c
+ * html2md_engine *engine = html2md_engine_new(NULL);
+ * size_t needed = 0;
+ * char out[4096];
+ * if (html2md_convert(engine, html, html_size, out, sizeof(out), &needed) ==
+ *     HTML2MD_BUFFER_TOO_SMALL) {
+ *   const char *md;
+ *   html2md_output(engine, &md, &needed); // The Markdown is kept
+ * }
+ * html2md_engine_free(engine);
+ * ```
+ *
+ * An engine must not be used by several threads at the same time, but any
+ * number of engines can convert concurrently.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*!
+ * \brief Version of this interface, raised when a function or a field of a
+ * struct is added
+ */
+#define HTML2MD_C_API_VERSION 1
+
+/*!
+ * \brief Result of the functions of the C interface
+ */
+typedef enum html2md_status {
+  HTML2MD_OK = 0,
+  /*! The output buffer is too small, see `needed`. The Markdown is kept and
+   * can be read with html2md_output(). */
+  HTML2MD_BUFFER_TOO_SMALL = 1,
+  /*! A pointer was NULL or a function was called out of order */
+  HTML2MD_INVALID_ARGUMENT = 2,
+  /*! Memory ran out */
+  HTML2MD_OUT_OF_MEMORY = 3,
+  /*! Any other error, see html2md_engine_error() */
+  HTML2MD_ERROR = 4
+} html2md_status;
+
+/*!
+ * \brief Options of a conversion, see html2md::Options for their meaning
+ *
+ * Set struct_size to sizeof(html2md_options) and initialize with
+ * html2md_options_init(), so fields added later get their default value. A
+ * library with more fields than the caller's header neither reads nor writes
+ * past struct_size.
+ */
+typedef struct html2md_options {
+  /*! sizeof(html2md_options), set by the caller */
+  size_t struct_size;
+
+  int split_lines;
+  int soft_break;
+  int hard_break;
+  char unordered_list;
+  char ordered_list;
+  int include_title;
+  int format_table;
+  int force_left_trim;
+  int compress_whitespace;
+  int escape_numbered_list;
+  int escape_markdown;
+  int keep_html_entities;
+  unsigned threads;
+
+  /*! Fill all of html2md_stats, which makes the conversion slower. Without it
+   * only the sizes are set. Not supported by html2md_feed(). */
+  int collect_stats;
+} html2md_options;
+
+/*!
+ * \brief Statistics of the last conversion, see html2md::ConversionStats
+ *
+ * Set struct_size to sizeof(html2md_stats) before html2md_engine_stats(),
+ * which writes no field past it.
+ */
+typedef struct html2md_stats {
+  /*! sizeof(html2md_stats), set by the caller */
+  size_t struct_size;
+
+  size_t input_bytes;
+  size_t output_bytes;
+  size_t estimated_output_bytes;
+  size_t tags;
+  size_t ignored_bytes;
+  size_t entities_decoded;
+  size_t tables_formatted;
+  size_t table_cells;
+  size_t reallocations;
+  uint64_t tokenize_ns;
+  uint64_t tidy_ns;
+  uint64_t entities_ns;
+  uint64_t replace_ns;
+  uint64_t table_ns;
+  uint64_t wrap_ns;
+  uint64_t total_ns;
+} html2md_stats;
+
+typedef struct html2md_engine html2md_engine;
+
+/*!
+ * \brief Set options to the defaults of html2md::Options
+ * \return HTML2MD_OK, or HTML2MD_INVALID_ARGUMENT if options is NULL or
+ * options->struct_size is smaller than the first version of the struct.
+ */
+html2md_status html2md_options_init(html2md_options *options);
+
+/*!
+ * \brief Create an engine
+ * \param options Options of all conversions of the engine, NULL for the
+ * defaults. They are copied.
+ * \return The engine, or NULL if memory ran out or options->struct_size is
+ * too small. Free it with html2md_engine_free().
+ */
+html2md_engine *html2md_engine_new(const html2md_options *options);
+
+/*!
+ * \brief Free an engine and its output, NULL is ignored
+ */
+void html2md_engine_free(html2md_engine *engine);
+
+/*!
+ * \brief Convert HTML to Markdown
+ * \param engine The engine.
+ * \param html The HTML, read in place. Needs no terminating NUL.
+ * \param size Length of the HTML in bytes.
+ * \param out Buffer for the Markdown, may be NULL if cap is 0.
+ * \param cap Size of out. If it is larger than the Markdown, a NUL is
+ * appended.
+ * \param needed Set to the length of the Markdown in bytes without NUL, may
+ * be NULL.
+ * \return HTML2MD_OK, or HTML2MD_BUFFER_TOO_SMALL if out can't hold the
+ * Markdown. Then nothing is written to out. HTML2MD_INVALID_ARGUMENT while a
+ * conversion started with html2md_feed() isn't finished.
+ */
+html2md_status html2md_convert(html2md_engine *engine, const char *html,
+                               size_t size, char *out, size_t cap,
+                               size_t *needed);
+
+/*!
+ * \brief Convert the next chunk of HTML
+ *
+ * The chunks are converted as they arrive and not kept. A chunk may end
+ * anywhere, even within a tag. Call html2md_finish() after the last one.
+ */
+html2md_status html2md_feed(html2md_engine *engine, const char *chunk,
+                            size_t size);
+
+/*!
+ * \brief Finish a conversion started with html2md_feed()
+ *
+ * The parameters and the result are the same as for html2md_convert(). The
+ * next html2md_feed() starts a new conversion.
+ */
+html2md_status html2md_finish(html2md_engine *engine, char *out, size_t cap,
+                              size_t *needed);
+
+/*!
+ * \brief Borrow the Markdown of the last conversion
+ * \param engine The engine.
+ * \param data Set to the Markdown, which is NUL terminated. Valid until the
+ * next call with this engine.
+ * \param size Set to the length of the Markdown in bytes.
+ */
+html2md_status html2md_output(const html2md_engine *engine, const char **data,
+                              size_t *size);
+
+/*!
+ * \brief Get the statistics of the last conversion
+ * \return HTML2MD_OK, or HTML2MD_INVALID_ARGUMENT if stats->struct_size is
+ * smaller than the first version of the struct.
+ */
+html2md_status html2md_engine_stats(const html2md_engine *engine,
+                                    html2md_stats *stats);
+
+/*!
+ * \brief Message of the last error of the engine, empty if there was none
+ */
+const char *html2md_engine_error(const html2md_engine *engine);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif // HTML2MD_C_H
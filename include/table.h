@@ -4,8 +4,13 @@
 #ifndef TABLE_H
 #define TABLE_H
 
+#include <cstddef>
 #include <string>
 
 [[nodiscard]] std::string formatMarkdownTable(const std::string &inputTable);
 
+// Appends the formatted table [table, table + size) to *out, which must not
+// hold the table itself
+void formatMarkdownTable(const char *table, size_t size, std::string *out);
+
 #endif // TABLE_H
@@ -0,0 +1,107 @@
+// Copyright (c) Tim Gromeyer
+// Licensed under the MIT License - https://opensource.org/licenses/MIT
+
+#ifndef HTML2MD_TRACE_H
+#define HTML2MD_TRACE_H
+
+/*!
+ * \file trace.h
+ * \brief Optional tracing of conversion phases and tag handlers
+ *
+ * Tracing is compiled in only if html2md is configured with
+ * `-DHTML2MD_TRACING=ON`; otherwise the trace points expand to nothing and
+ * this API is not available.
+ *
+ * When enabled, every phase of Converter::convert() and every tag handler
+ * emits a begin and an end event. They are passed to the callback set with
+ * html2md::trace::setCallback() and, if `<sys/sdt.h>` was found at configure
+ * time, fired as USDT probes `html2md:begin` and `html2md:end` with the phase
+ * and the tag name as arguments, e.g.:
+ *
+ * ```sh
+ * bpftrace -e 'usdt:./libhtml2md.so:html2md:begin /arg0 == 6/
+ *              { @start[tid] = nsecs; }
+ *              usdt:./libhtml2md.so:html2md:end /arg0 == 6/
+ *              { @ns[str(arg1)] = hist(nsecs - @start[tid]); }'
+ * ```
+ */
+
+#ifdef HTML2MD_TRACING
+
+#include <cstdint>
+
+namespace html2md {
+namespace trace {
+
+/*!
+ * \brief What is being traced
+ *
+ * The numeric values are passed to the USDT probes and are stable.
+ */
+enum Phase : uint8_t {
+  kConvert = 0,     //!< The whole conversion
+  kTokenize = 1,    //!< Parsing the HTML and running the tag handlers
+  kTidy = 2,        //!< Trimming lines, see detail::TidyAllLines()
+  kEntities = 3,    //!< Replacing HTML entities
+  kReplace = 4,     //!< Final search-and-replace clean up
+  kTable = 5,       //!< Formatting a table
+  kOpeningTag = 6,  //!< Tag handler for an opening tag, name is the tag
+  kClosingTag = 7,  //!< Tag handler for a closing tag, name is the tag
+  kWrap = 8,        //!< Wrapping long lines
+};
+
+/*!
+ * \brief Called at the begin and end of every traced phase
+ * \param phase The phase
+ * \param name The tag name for tag handlers, otherwise an empty string
+ * \param begin true at the begin, false at the end of the phase
+ * \param userData The pointer passed to setCallback()
+ *
+ * \note The callback is called from the thread doing the conversion and must
+ * be thread-safe if several conversions run in parallel.
+ */
+using Callback = void (*)(Phase phase, const char *name, bool begin,
+                          void *userData);
+
+/*!
+ * \brief Set the function receiving trace events
+ * \param callback The callback, nullptr to disable it
+ * \param userData Passed to every call of the callback
+ */
+void setCallback(Callback callback, void *userData = nullptr);
+
+/*!
+ * \brief Emits the begin event on construction and the end event when
+ * destroyed
+ */
+class Scope {
+public:
+  Scope(Phase phase, const char *name);
+  ~Scope();
+
+  Scope(const Scope &) = delete;
+  Scope &operator=(const Scope &) = delete;
+
+private:
+  Phase phase_;
+  const char *name_;
+};
+
+} // namespace trace
+} // namespace html2md
+
+#define HTML2MD_TRACE_CONCAT2(a, b) a##b
+#define HTML2MD_TRACE_CONCAT(a, b) HTML2MD_TRACE_CONCAT2(a, b)
+#define HTML2MD_TRACE_SCOPE(phase, name)                                       \
+  ::html2md::trace::Scope HTML2MD_TRACE_CONCAT(html2md_trace_, __LINE__)(      \
+      ::html2md::trace::phase, name)
+
+#else
+
+#define HTML2MD_TRACE_SCOPE(phase, name)                                       \
+  do {                                                                         \
+  } while (false)
+
+#endif // HTML2MD_TRACING
+
+#endif // HTML2MD_TRACE_H
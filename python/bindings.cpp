@@ -1,20 +1,199 @@
 #include <html2md.h>
+#include <internal.h>
 #include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
+
+#include <algorithm>
+#include <atomic>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
 namespace py = pybind11;
 
+namespace {
+// Convert every document of htmls on up to `threads` native threads, 0 for
+// one per core. Must be called without the GIL.
+std::vector<std::string> ConvertMany(const std::vector<std::string> &htmls,
+                                     const html2md::Options &options,
+                                     unsigned threads) {
+  std::vector<std::string> mds(htmls.size());
+
+  if (threads == 0)
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  const size_t count =
+      std::min<size_t>(threads, std::max<size_t>(htmls.size(), 1));
+
+  // Each thread takes the next document until none is left or one failed
+  std::atomic<size_t> next(0);
+  html2md::detail::RunConcurrently(count, [&](size_t) {
+    try {
+      for (size_t i = next++; i < htmls.size(); i = next++) {
+        html2md::Options o = options;
+        html2md::Converter c(htmls[i], &o);
+        mds[i] = c.convert();
+      }
+    } catch (...) {
+      next = htmls.size();
+      throw;
+    }
+  });
+
+  return mds;
+}
+
+// Marks an object as converting, which releases the GIL. Created and
+// destroyed with the GIL held, so two threads can't use the object at the
+// same time.
+class Busy {
+public:
+  Busy(bool *busy, const char *name) : busy_(busy) {
+    if (*busy_)
+      throw std::runtime_error(std::string(name) +
+                               " is used by another thread");
+    *busy_ = true;
+  }
+  ~Busy() { *busy_ = false; }
+
+  Busy(const Busy &) = delete;
+  Busy &operator=(const Busy &) = delete;
+
+private:
+  bool *busy_;
+};
+
+// html2md::Converter, which can't be used while it converts
+class Converter : public html2md::Converter {
+public:
+  using html2md::Converter::Converter;
+
+  // Throw if another thread is converting
+  void check() const {
+    if (busy_)
+      throw std::runtime_error("Converter is used by another thread");
+  }
+
+  std::string convert(html2md::ConversionStats *stats) {
+    Busy busy(&busy_, "Converter");
+    py::gil_scoped_release release;
+    return html2md::Converter::convert(stats);
+  }
+
+private:
+  bool busy_ = false;
+};
+
+// A contiguous view of an object supporting the buffer protocol
+class BufferView {
+public:
+  explicit BufferView(const py::object &object) {
+    if (PyObject_GetBuffer(object.ptr(), &view_, PyBUF_SIMPLE) != 0)
+      throw py::error_already_set();
+  }
+  ~BufferView() { PyBuffer_Release(&view_); }
+
+  BufferView(const BufferView &) = delete;
+  BufferView &operator=(const BufferView &) = delete;
+
+  const char *data() const { return static_cast<const char *>(view_.buf); }
+  size_t size() const { return static_cast<size_t>(view_.len); }
+
+private:
+  Py_buffer view_;
+};
+
+// Convert HTML read in place. Must be called without the GIL.
+std::string ConvertBuffer(const char *html, size_t size,
+                          html2md::Options options) {
+  if (options.threads != 1) {
+    // The parallel conversion needs all of the HTML in the Converter
+    html2md::Converter c(std::string(html, size), &options);
+    return c.convert();
+  }
+
+  html2md::Converter c(std::string(), &options);
+  c.feed(html, size);
+  return c.finish();
+}
+
+// Converts HTML that arrives in chunks, see Converter::feed()
+class StreamConverter {
+public:
+  explicit StreamConverter(html2md::Options *options)
+      : converter_(std::string(), options) {}
+
+  // Returns the Markdown that is final, see Converter::flush()
+  std::string feed(const char *chunk, size_t size) {
+    Busy busy(&busy_, "StreamConverter");
+    checkOpen();
+    py::gil_scoped_release release;
+    converter_.feed(chunk, size);
+    return converter_.flush();
+  }
+
+  std::string close() {
+    std::string md;
+    {
+      Busy busy(&busy_, "StreamConverter");
+      checkOpen();
+      py::gil_scoped_release release;
+      md = converter_.finish();
+    }
+    closed_ = true;
+    return md;
+  }
+
+private:
+  void checkOpen() const {
+    if (closed_)
+      throw std::runtime_error("StreamConverter is closed");
+  }
+
+  html2md::Converter converter_;
+  bool busy_ = false;
+  bool closed_ = false;
+};
+
+py::dict StatsToDict(const html2md::ConversionStats &stats) {
+  py::dict tags;
+  for (const auto &tag : stats.tags)
+    tags[py::str(tag.first)] = tag.second;
+
+  py::dict d;
+  d["input_bytes"] = stats.inputBytes;
+  d["output_bytes"] = stats.outputBytes;
+  d["estimated_output_bytes"] = stats.estimatedOutputBytes;
+  d["tags"] = tags;
+  d["ignored_bytes"] = stats.ignoredBytes;
+  d["entities_decoded"] = stats.entitiesDecoded;
+  d["tables_formatted"] = stats.tablesFormatted;
+  d["table_cells"] = stats.tableCells;
+  d["reallocations"] = stats.reallocations;
+  d["tokenize_ns"] = stats.tokenizeNs;
+  d["tidy_ns"] = stats.tidyNs;
+  d["entities_ns"] = stats.entitiesNs;
+  d["replace_ns"] = stats.replaceNs;
+  d["table_ns"] = stats.tableNs;
+  d["wrap_ns"] = stats.wrapNs;
+  d["total_ns"] = stats.totalNs;
+  return d;
+}
+} // namespace
+
 PYBIND11_MODULE(pyhtml2md, m) {
   m.doc() = "Python bindings for html2md"; // optional module docstring
 
   // Options class bindings
   py::class_<html2md::Options>(m, "Options")
       .def(py::init<>())
-      .def_readwrite(
-          "splitLines", &html2md::Options::splitLines,
-          "Add new line when a certain number of characters is reached")
+      .def_readwrite("splitLines", &html2md::Options::splitLines,
+                     "Wrap long lines of the generated Markdown")
       .def_readwrite("softBreak", &html2md::Options::softBreak,
-                     "Wrap after ... characters when the next space is reached")
-      .def_readwrite("hardBreak", &html2md::Options::hardBreak,
-                     "Force a break after ... characters in a line")
+                     "Wrap at the next space once a line is ... columns wide")
+      .def_readwrite(
+          "hardBreak", &html2md::Options::hardBreak,
+          "Wrap at the previous space once a line is wider than ... columns")
       .def_readwrite("unorderedList", &html2md::Options::unorderedList,
                      "The char used for unordered lists")
       .def_readwrite("orderedList", &html2md::Options::orderedList,
@@ -27,35 +206,166 @@ PYBIND11_MODULE(pyhtml2md, m) {
       .def_readwrite("forceLeftTrim", &html2md::Options::forceLeftTrim,
                      "Whether to force left trim")
       .def_readwrite("compressWhitespace", &html2md::Options::compressWhitespace,
-                     "Whether to compress whitespace (tabs, multiple spaces) "
-                     "into a single space")
+                     "Whether to compress whitespace (tabs, newlines, multiple "
+                     "spaces) into a single space")
       .def_readwrite("escapeNumberedList", &html2md::Options::escapeNumberedList,
                      "Whether to escape numbered lists (e.g. '4.' -> '4\\.')")
+      .def_readwrite("escapeMarkdown", &html2md::Options::escapeMarkdown,
+                     "Whether to escape all text that Markdown would read as "
+                     "markup")
      .def_readwrite("keepHtmlEntities", &html2md::Options::keepHtmlEntities,
                   "Whether to keep HTML entities (e.g. '&nbsp;') in the output")
+      .def_readwrite("threads", &html2md::Options::threads,
+                     "Threads used to convert large documents, 0 for one per "
+                     "core")
       .def("__eq__", &html2md::Options::operator==);
 
-  py::class_<html2md::Converter>(m, "Converter")
+  // Converter releases the GIL while converting. Using it from another thread
+  // meanwhile raises RuntimeError.
+  py::class_<Converter>(m, "Converter")
+      .def(py::init([](const py::buffer &html, html2md::Options *options) {
+             BufferView view(html);
+             return new Converter(std::string(view.data(), view.size()),
+                                  options);
+           }),
+           "Class for converting HTML to Markdown, given as bytes-like object",
+           py::arg("html"), py::arg("options") = py::none())
       .def(py::init<std::string &, html2md::Options *>(),
            "Class for converting HTML to Markdown", py::arg("html"),
            py::arg("options") = py::none())
-      .def("convert", &html2md::Converter::convert,
-           "This function actually converts the HTML into Markdown.")
-      .def("ok", &html2md::Converter::ok,
-           "Checks if everything was closed properly(in the HTML).")
-      .def("add_html_symbol_conversion",
-           &html2md::Converter::addHtmlSymbolConversion,
-           "Add or modify an HTML symbol conversion", py::arg("html_symbol"),
-           py::arg("replacement"))
-      .def("remove_html_symbol_conversion",
-           &html2md::Converter::removeHtmlSymbolConversion,
-           "Remove an HTML symbol conversion", py::arg("html_symbol"))
-      .def("clear_html_symbol_conversions",
-           &html2md::Converter::clearHtmlSymbolConversions,
-           "Clear all HTML symbol conversions")
-      .def("__call__", &html2md::Converter::operator bool);
+      .def(
+          "convert", [](Converter &c) { return c.convert(nullptr); },
+          "This function actually converts the HTML into Markdown. The GIL "
+          "is released meanwhile.")
+      .def(
+          "convert_with_stats",
+          [](Converter &c) {
+            html2md::ConversionStats stats;
+            std::string md = c.convert(&stats);
+            return py::make_tuple(md, StatsToDict(stats));
+          },
+          "Convert the HTML into Markdown and return a tuple of the Markdown "
+          "and a dict with statistics about the conversion.")
+      .def(
+          "ok",
+          [](const Converter &c) {
+            c.check();
+            return c.ok();
+          },
+          "Checks if everything was closed properly(in the HTML).")
+      .def(
+          "add_html_symbol_conversion",
+          [](Converter &c, const std::string &html_symbol,
+             const std::string &replacement) {
+            c.check();
+            c.addHtmlSymbolConversion(html_symbol, replacement);
+          },
+          "Add or modify an HTML symbol conversion", py::arg("html_symbol"),
+          py::arg("replacement"))
+      .def(
+          "remove_html_symbol_conversion",
+          [](Converter &c, const std::string &html_symbol) {
+            c.check();
+            c.removeHtmlSymbolConversion(html_symbol);
+          },
+          "Remove an HTML symbol conversion", py::arg("html_symbol"))
+      .def(
+          "clear_html_symbol_conversions",
+          [](Converter &c) {
+            c.check();
+            c.clearHtmlSymbolConversions();
+          },
+          "Clear all HTML symbol conversions")
+      .def("__call__", [](const Converter &c) {
+        c.check();
+        return static_cast<bool>(c);
+      });
+
+  py::class_<StreamConverter>(m, "StreamConverter")
+      .def(py::init<html2md::Options *>(),
+           "Class for converting HTML that arrives in chunks, e.g. a streamed "
+           "HTTP response, without keeping all of it",
+           py::arg("options") = py::none())
+      .def(
+          "feed",
+          [](StreamConverter &s, const py::buffer &chunk, bool as_bytes) {
+            std::string md;
+            {
+              BufferView view(chunk);
+              md = s.feed(view.data(), view.size());
+            }
+            if (as_bytes)
+              return py::object(py::bytes(md));
+            return py::object(py::str(md));
+          },
+          "Convert the next chunk of HTML, given as UTF-8 bytes-like object. "
+          "A chunk may end anywhere, even within a tag or a UTF-8 sequence. "
+          "The GIL is released meanwhile. Returns the Markdown that is "
+          "finished, whole paragraphs outside of tables and code blocks, as "
+          "UTF-8 bytes with as_bytes. It is often empty.",
+          py::arg("chunk"), py::arg("as_bytes") = false)
+      .def(
+          "feed",
+          [](StreamConverter &s, const std::string &chunk, bool as_bytes) {
+            std::string md = s.feed(chunk.data(), chunk.size());
+            if (as_bytes)
+              return py::object(py::bytes(md));
+            return py::object(py::str(md));
+          },
+          "Convert the next chunk of HTML, see above", py::arg("chunk"),
+          py::arg("as_bytes") = false)
+      .def(
+          "close",
+          [](StreamConverter &s, bool as_bytes) {
+            std::string md = s.close();
+            if (as_bytes)
+              return py::object(py::bytes(md));
+            return py::object(py::str(md));
+          },
+          "Finish the conversion and return the rest of the Markdown, as "
+          "UTF-8 bytes with as_bytes. The converter can't be fed afterwards.",
+          py::arg("as_bytes") = false);
+
+  // Registered first, as bytes would be accepted by the std::string overload
+  m.def(
+      "convert",
+      [](const py::buffer &html, html2md::Options *options, bool as_bytes) {
+        const html2md::Options o = options ? *options : html2md::Options();
+        std::string md;
+        {
+          BufferView view(html);
+          py::gil_scoped_release release;
+          md = ConvertBuffer(view.data(), view.size(), o);
+        }
+
+        if (as_bytes)
+          return py::object(py::bytes(md));
+        return py::object(py::str(md));
+      },
+      "Convert HTML given as bytes-like object (bytes, bytearray, memoryview, "
+      "mmap, ...), which is read in place and not decoded. The GIL is "
+      "released meanwhile. With as_bytes the Markdown is returned as UTF-8 "
+      "bytes instead of str.",
+      py::arg("html"), py::arg("options") = py::none(),
+      py::arg("as_bytes") = false);
 
   m.def("convert", &html2md::Convert,
-        "Static wrapper around the Converter class", py::arg("html"),
-        py::arg("ok") = py::none());
+        "Static wrapper around the Converter class. The GIL is released "
+        "meanwhile.",
+        py::arg("html"), py::arg("ok") = py::none(),
+        py::call_guard<py::gil_scoped_release>());
+
+  m.def(
+      "convert_many",
+      [](const std::vector<std::string> &htmls, html2md::Options *options,
+         unsigned threads) {
+        const html2md::Options o = options ? *options : html2md::Options();
+        py::gil_scoped_release release;
+        return ConvertMany(htmls, o, threads);
+      },
+      "Convert a list of HTML documents to a list of Markdown documents on a "
+      "pool of native threads, 0 for one per core. The GIL is released "
+      "meanwhile.",
+      py::arg("htmls"), py::arg("options") = py::none(),
+      py::arg("threads") = 0);
 }
\ No newline at end of file
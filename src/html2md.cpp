@@ -2,13 +2,19 @@
 // Licensed under the MIT License - https://opensource.org/licenses/MIT
 
 #include "html2md.h"
+#include "internal.h"
 #include "table.h"
+#include "trace.h"
 
 #include <algorithm>
 #include <cctype>
+#include <chrono>
 #include <cstring>
+#include <exception>
 #include <memory>
 #include <sstream>
+#include <system_error>
+#include <thread>
 #include <vector>
 
 using std::make_shared;
@@ -26,6 +32,467 @@ bool endsWith(const string &str, const string &suffix) {
          0 == str.compare(str.size() - suffix.size(), suffix.size(), suffix);
 }
 
+size_t ReplaceAll(string *haystack, const string &needle, const char c) {
+  return html2md::detail::ReplaceAll(haystack, needle, string({c}));
+}
+
+// Split given string by given character delimiter into vector of strings
+vector<string> Split(string const &str, char delimiter) {
+  vector<string> result;
+  std::stringstream iss(str);
+
+  for (string token; getline(iss, token, delimiter);)
+    result.push_back(token);
+
+  return result;
+}
+
+string Repeat(const string &str, size_t amount) {
+  if (amount == 0)
+    return "";
+  else if (amount == 1)
+    return str;
+
+  // Optimize for single-character strings (common case for blockquotes, etc.)
+  if (str.size() == 1)
+    return string(amount, str[0]);
+
+  // For multi-character strings, reserve space upfront
+  string out;
+  out.reserve(str.size() * amount);
+  for (size_t i = 0; i < amount; ++i)
+    out.append(str);
+
+  return out;
+}
+
+// Case-insensitive search for the lowercase needle in [str, str + len)
+size_t FindCaseInsensitive(const char *str, size_t len, const string &needle) {
+  if (needle.empty() || needle.size() > len)
+    return string::npos;
+
+  for (size_t i = 0; i + needle.size() <= len; ++i) {
+    size_t j = 0;
+    while (j < needle.size() &&
+           tolower(static_cast<unsigned char>(str[i + j])) == needle[j])
+      ++j;
+
+    if (j == needle.size())
+      return i;
+  }
+
+  return string::npos;
+}
+
+// Whether the tag name in [name, name + len) equals `tag` (lowercase)
+bool TagNameIs(const char *name, size_t len, const char *tag) {
+  for (size_t i = 0; i < len; ++i, ++tag)
+    if (*tag == '\0' || tolower(static_cast<unsigned char>(name[i])) != *tag)
+      return false;
+
+  return *tag == '\0';
+}
+
+// Predict the size of the Markdown generated from `html`, so the output can be
+// reserved once instead of guessing a fixed ratio of the input:
+// - text between tags is copied, escaped chars take two bytes
+// - markup mostly disappears, except for a few bytes per tag and the
+//   attributes of links and images
+// - the content of ignored elements (script, style, ...) is dropped
+size_t EstimateMarkdownSize(const char *html, size_t size) {
+  static const char *const kIgnored[] = {"script", "style", "template",
+                                         "noscript", "nav"};
+
+  const char *p = html;
+  const char *end = p + size;
+
+  size_t text = 0;
+  size_t escapes = 0;
+  size_t tags = 0;
+  size_t attributes = 0;
+
+  while (p < end) {
+    auto *lt = static_cast<const char *>(memchr(p, '<', end - p));
+    const char *text_end = lt ? lt : end;
+
+    text += text_end - p;
+    for (; p < text_end; ++p)
+      escapes += *p == '*' || *p == '`' || *p == '\\';
+
+    if (lt == nullptr)
+      break;
+
+    auto *gt = static_cast<const char *>(memchr(lt, '>', end - lt));
+    if (gt == nullptr)
+      break;
+
+    ++tags;
+    p = gt + 1;
+
+    const char *name = lt + 1;
+    bool closing = name < gt && *name == '/';
+    if (closing)
+      ++name;
+
+    const char *name_end = name;
+    while (name_end < gt && isalnum(static_cast<unsigned char>(*name_end)))
+      ++name_end;
+
+    size_t name_len = name_end - name;
+
+    if (TagNameIs(name, name_len, "a") || TagNameIs(name, name_len, "img")) {
+      attributes += gt - name_end;
+      continue;
+    }
+
+    if (closing)
+      continue;
+
+    for (const char *ignored : kIgnored) {
+      if (!TagNameIs(name, name_len, ignored))
+        continue;
+
+      // Skip to the matching closing tag
+      const char *q = p;
+      while ((q = static_cast<const char *>(memchr(q, '<', end - q)))) {
+        if (q + 1 + name_len < end && q[1] == '/' &&
+            TagNameIs(q + 2, name_len, ignored))
+          break;
+        ++q;
+      }
+      p = q ? q : end;
+      break;
+    }
+  }
+
+  // Leave some headroom for list markers, table borders and the like
+  size_t estimate = text + escapes + tags * 2 + attributes;
+  return estimate + estimate / 8 + 64;
+}
+
+// Classes of bytes the tokenizer distinguishes
+enum CharClass : uint8_t {
+  kClassText,        // Anything else
+  kClassSpace,       // ' ', '\t', '\v', '\f', '\r'
+  kClassNewline,     // '\n'
+  kClassLess,        // '<'
+  kClassGreater,     // '>'
+  kClassSlash,       // '/'
+  kClassDoubleQuote, // '"'
+  kClassSingleQuote, // '\''
+  kClassEscape,      // '*', '`', '\\', '.': may need escaping in text
+};
+
+inline bool IsVerbatimText(uint8_t c) {
+  return c == kClassText || (c >= kClassGreater && c <= kClassSingleQuote);
+}
+
+// Class and lowercase of every byte. Unlike isspace() and tolower() this
+// doesn't depend on the locale, and bytes >= 0x80 are always text.
+// markdown_classes is used for text with Options::escapeMarkdown, where more
+// chars may need escaping.
+struct ByteTable {
+  uint8_t classes[256];
+  uint8_t markdown_classes[256];
+  char lower[256];
+
+  ByteTable() {
+    for (int i = 0; i < 256; ++i) {
+      classes[i] = kClassText;
+      lower[i] = static_cast<char>(i >= 'A' && i <= 'Z' ? i - 'A' + 'a' : i);
+    }
+
+    for (unsigned char ch : {' ', '\t', '\v', '\f', '\r'})
+      classes[ch] = kClassSpace;
+    for (unsigned char ch : {'*', '`', '\\', '.'})
+      classes[ch] = kClassEscape;
+    classes[static_cast<unsigned char>('\n')] = kClassNewline;
+    classes[static_cast<unsigned char>('<')] = kClassLess;
+    classes[static_cast<unsigned char>('>')] = kClassGreater;
+    classes[static_cast<unsigned char>('/')] = kClassSlash;
+    classes[static_cast<unsigned char>('"')] = kClassDoubleQuote;
+    classes[static_cast<unsigned char>('\'')] = kClassSingleQuote;
+
+    memcpy(markdown_classes, classes, sizeof(classes));
+    for (unsigned char ch : {'_', '[', ']', '|', '#', '-', '+', '>', '&', ';'})
+      markdown_classes[ch] = kClassEscape;
+  }
+};
+
+const ByteTable kBytes;
+
+inline CharClass ClassOf(char ch) {
+  return static_cast<CharClass>(kBytes.classes[static_cast<unsigned char>(ch)]);
+}
+
+inline char ToLower(char ch) {
+  return kBytes.lower[static_cast<unsigned char>(ch)];
+}
+
+inline bool IsSpace(char ch) {
+  CharClass c = ClassOf(ch);
+  return c == kClassSpace || c == kClassNewline;
+}
+
+// ASCII whitespace as HTML defines it, unlike IsSpace() without '\v'
+inline bool IsHtmlSpace(char ch) {
+  return ch == ' ' || ch == '\t' || ch == '\n' || ch == '\r' || ch == '\f';
+}
+
+inline bool IsAsciiDigit(char ch) { return ch >= '0' && ch <= '9'; }
+
+inline bool IsAsciiAlnum(char ch) {
+  return IsAsciiDigit(ch) || (ch >= 'a' && ch <= 'z') ||
+         (ch >= 'A' && ch <= 'Z');
+}
+
+// Columns taken by the UTF-8 sequence starting at str[0], which is no
+// continuation byte. *len is set to the length of the sequence.
+size_t DisplayWidth(const unsigned char *str, size_t available, size_t *len) {
+  if (str[0] < 0xC0 || available < 2) {
+    *len = 1;
+    return 1;
+  }
+
+  uint32_t code;
+  if (str[0] < 0xE0) {
+    *len = 2;
+    return 1;
+  } else if (str[0] < 0xF0 && available >= 3) {
+    *len = 3;
+    code = (str[0] & 0x0Fu) << 12 | (str[1] & 0x3Fu) << 6 | (str[2] & 0x3Fu);
+  } else if (available >= 4) {
+    *len = 4;
+    code = (str[0] & 0x07u) << 18 | (str[1] & 0x3Fu) << 12 |
+           (str[2] & 0x3Fu) << 6 | (str[3] & 0x3Fu);
+  } else {
+    *len = 1;
+    return 1;
+  }
+
+  // East Asian wide and fullwidth characters and emoji take two columns
+  const bool wide = (code >= 0x1100 && code <= 0x115F) ||
+                    (code >= 0x2E80 && code <= 0xA4CF && code != 0x303F) ||
+                    (code >= 0xAC00 && code <= 0xD7A3) ||
+                    (code >= 0xF900 && code <= 0xFAFF) ||
+                    (code >= 0xFE30 && code <= 0xFE4F) ||
+                    (code >= 0xFF00 && code <= 0xFF60) ||
+                    (code >= 0xFFE0 && code <= 0xFFE6) ||
+                    (code >= 0x1F300 && code <= 0x1F64F) ||
+                    (code >= 0x1F900 && code <= 0x1F9FF) ||
+                    (code >= 0x20000 && code <= 0x3FFFD);
+  return wide ? 2 : 1;
+}
+
+// Would a line starting at str[0] begin a block (heading, list item, quote,
+// setext underline, thematic break or code fence) instead of continuing the
+// paragraph?
+bool StartsBlock(const char *str, size_t len) {
+  switch (str[0]) {
+  case '#':
+  case '>':
+  case '-':
+  case '+':
+  case '=':
+    return true;
+  case '*':
+  case '_':
+    return len == 1 || str[1] == ' ';
+  case '`':
+  case '~':
+    return len >= 3 && str[1] == str[0] && str[2] == str[0];
+  default:
+    break;
+  }
+
+  // Ordered list item: up to 9 digits followed by '.' or ')'
+  size_t digits = 0;
+  while (digits < len && digits < 10 && str[digits] >= '0' &&
+         str[digits] <= '9')
+    ++digits;
+
+  return digits != 0 && digits < 10 && digits < len &&
+         (str[digits] == '.' || str[digits] == ')');
+}
+
+// Could a line starting at str[0] begin an HTML block? A '<' followed by
+// anything else is text.
+bool StartsHtmlBlock(const char *str, size_t len) {
+  if (len < 2 || str[0] != '<')
+    return false;
+
+  const char next = str[1];
+  return (next >= 'a' && next <= 'z') || (next >= 'A' && next <= 'Z') ||
+         next == '/' || next == '!' || next == '?';
+}
+
+// Is [str, str + len) the delimiter row of a table, like "| --- | :-: |"?
+bool IsTableDelimiterRow(const char *str, size_t len) {
+  bool has_pipe = false;
+  bool has_dash = false;
+
+  for (size_t i = 0; i < len; ++i) {
+    switch (str[i]) {
+    case '|':
+      has_pipe = true;
+      break;
+    case '-':
+      has_dash = true;
+      break;
+    case ':':
+    case ' ':
+    case '\t':
+      break;
+    default:
+      return false;
+    }
+  }
+
+  return has_pipe && has_dash;
+}
+
+// Width of the list marker ("- ", "12. ") at str[0], 0 if there is none
+size_t ListMarkerWidth(const char *str, size_t len) {
+  if (len >= 2 && (str[0] == '-' || str[0] == '+' || str[0] == '*') &&
+      str[1] == ' ')
+    return 2;
+
+  size_t digits = 0;
+  while (digits < len && digits < 10 && str[digits] >= '0' &&
+         str[digits] <= '9')
+    ++digits;
+
+  if (digits != 0 && digits < 10 && digits + 1 < len &&
+      (str[digits] == '.' || str[digits] == ')') && str[digits + 1] == ' ')
+    return digits + 2;
+
+  return 0;
+}
+
+// Offsets of the '[' in [str, str + len) that open a link, i.e. whose ']'
+// is directly followed by '('. Escaped chars and code spans are skipped the
+// same way as in WrapLines(). The offsets are sorted.
+void FindLinkOpeners(const char *str, size_t len, vector<size_t> *openers,
+                     vector<size_t> *open) {
+  openers->clear();
+  open->clear();
+  size_t code_run = 0;
+
+  for (size_t i = 0; i < len; ++i) {
+    if (str[i] == '`') {
+      size_t run = 1;
+      while (i + run < len && str[i + run] == '`')
+        ++run;
+
+      if (code_run == 0)
+        code_run = run;
+      else if (code_run == run)
+        code_run = 0;
+
+      i += run - 1;
+    } else if (code_run != 0) {
+      continue;
+    } else if (str[i] == '\\') {
+      ++i;
+    } else if (str[i] == '[') {
+      open->push_back(i);
+    } else if (str[i] == ']' && !open->empty()) {
+      if (i + 1 < len && str[i + 1] == '(')
+        openers->push_back(open->back());
+      open->pop_back();
+    }
+  }
+
+  std::sort(openers->begin(), openers->end());
+}
+
+// Adds the time spent in its scope to *ns; does nothing if ns is nullptr
+class ScopedTimer {
+public:
+  explicit ScopedTimer(uint64_t *ns) : ns_(ns) {
+    if (ns_)
+      start_ = std::chrono::steady_clock::now();
+  }
+
+  ~ScopedTimer() {
+    if (ns_)
+      *ns_ += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                  std::chrono::steady_clock::now() - start_)
+                  .count();
+  }
+
+private:
+  uint64_t *ns_;
+  std::chrono::steady_clock::time_point start_;
+};
+
+// Markdown is only cleaned up in parallel in parts of at least this size,
+// smaller ones aren't worth starting a thread
+constexpr size_t kMinCleanUpPart = 256 * 1024;
+
+// Same for the HTML converted in parallel
+constexpr size_t kMinConvertPart = 256 * 1024;
+
+// HTML converted before a part, from the end of a block at most this far
+// before it, so the state of the conversion at the start of the part likely
+// matches the one of the serial conversion. The window grows up to
+// kMaxWarmUp to find the end of a block.
+constexpr size_t kWarmUp = 4 * 1024;
+constexpr size_t kMaxWarmUp = 64 * 1024;
+
+size_t ThreadCount(unsigned threads) {
+  return threads != 0 ? threads
+                      : std::max(std::thread::hardware_concurrency(), 1u);
+}
+
+// Offset after the first closing tag of a block element (`</p>`, `</div>`,
+// ...) that starts in [from, to) of html, or to if there is none
+size_t FindBlockEnd(const char *html, size_t from, size_t to) {
+  static const char *const kBlocks[] = {
+      "p",  "div", "table", "ul", "ol", "blockquote", "pre",    "h1",
+      "h2", "h3",  "h4",    "h5", "h6", "section",    "article"};
+
+  while (from < to) {
+    auto *lt = static_cast<const char *>(memchr(html + from, '<', to - from));
+    if (lt == nullptr)
+      break;
+
+    const char *name = lt + 1;
+    from = name - html;
+    if (from >= to || *name != '/')
+      continue;
+
+    const char *name_end = ++name;
+    while (name_end < html + to && IsAsciiAlnum(*name_end))
+      ++name_end;
+    if (name_end == html + to || *name_end != '>')
+      continue;
+
+    for (const char *block : kBlocks)
+      if (TagNameIs(name, name_end - name, block))
+        return name_end + 1 - html;
+  }
+
+  return to;
+}
+
+// Adds the counts of a conversion of part of the HTML to stats
+void AddPartStats(const html2md::ConversionStats &part,
+                  html2md::ConversionStats *stats) {
+  for (const auto &tag : part.tags)
+    stats->tags[tag.first] += tag.second;
+  stats->ignoredBytes += part.ignoredBytes;
+  stats->tablesFormatted += part.tablesFormatted;
+  stats->tableCells += part.tableCells;
+  stats->tableNs += part.tableNs;
+}
+
+} // namespace
+
+namespace html2md {
+
+namespace detail {
+
 size_t ReplaceAll(string *haystack, const string &needle,
                   const string &replacement) {
   // Get first occurrence
@@ -47,167 +514,700 @@ size_t ReplaceAll(string *haystack, const string &needle,
   return amount_replaced;
 }
 
-size_t ReplaceAll(string *haystack, const string &needle, const char c) {
-  return ReplaceAll(haystack, needle, string({c}));
+void TidyAllLines(string *str, bool forceLeftTrim) {
+  if (str->empty())
+    return;
+
+  // Ensure input ends with newline to simplify logic
+  if (str->back() != '\n') {
+    str->push_back('\n');
+  }
+
+  str->resize(TidyLines(&(*str)[0], str->size(), forceLeftTrim, false));
 }
 
-// Split given string by given character delimiter into vector of strings
-vector<string> Split(string const &str, char delimiter) {
-  vector<string> result;
-  std::stringstream iss(str);
+size_t TidyLines(char *data, size_t len, bool forceLeftTrim,
+                 bool in_code_block) {
+  size_t read = 0;
+  size_t write = 0;
 
-  for (string token; getline(iss, token, delimiter);)
-    result.push_back(token);
+  uint8_t amount_newlines = 0;
 
-  return result;
+  while (read < len) {
+    const size_t line_start = read;
+
+    // There always is a newline, the string ends with one
+    const size_t line_end =
+        static_cast<const char *>(memchr(data + read, '\n', len - read)) - data;
+
+    const size_t line_len = line_end - line_start;
+
+    // Check for code block markers
+    if (line_len >= 3) {
+      char c1 = data[line_start];
+      if ((c1 == '`' || c1 == '~') && data[line_start + 1] == c1 &&
+          data[line_start + 2] == c1) {
+        in_code_block = !in_code_block;
+      }
+    }
+
+    if (in_code_block) {
+      // Copy line as-is, including its newline
+      if (write != line_start)
+        memmove(data + write, data + line_start, line_len + 1);
+      write += line_len + 1;
+    } else {
+      // Trim logic
+      size_t trim_start = line_start;
+      size_t trim_end = line_end;
+
+      // Trim leading whitespace
+      if (forceLeftTrim || (trim_start < trim_end && data[trim_start] != '\t')) {
+        while (trim_start < trim_end && IsSpace(data[trim_start])) {
+          ++trim_start;
+        }
+      }
+
+      // Trim trailing whitespace, preserve "  "
+      bool has_line_break = false;
+      if (trim_end >= trim_start + 2 && data[trim_end - 1] == ' ' &&
+          data[trim_end - 2] == ' ') {
+        has_line_break = true;
+        trim_end -= 2;
+      }
+
+      while (trim_end > trim_start && IsSpace(data[trim_end - 1])) {
+        --trim_end;
+      }
+
+      if (has_line_break) {
+        trim_end += 2;
+      }
+
+      const size_t trimmed_len = trim_end - trim_start;
+
+      if (trimmed_len == 0) {
+        // Empty line
+        if (amount_newlines < 2 && write > 0) {
+          data[write++] = '\n';
+          amount_newlines++;
+        }
+      } else {
+        amount_newlines = 0;
+        if (write != trim_start)
+          memmove(data + write, data + trim_start, trimmed_len);
+        write += trimmed_len;
+        data[write++] = '\n';
+      }
+    }
+
+    read = line_end + 1;
+  }
+
+  return write;
 }
 
-string Repeat(const string &str, size_t amount) {
-  if (amount == 0)
-    return "";
-  else if (amount == 1)
-    return str;
+bool TogglesCodeBlock(const char *data, size_t len) {
+  bool toggles = false;
 
-  // Optimize for single-character strings (common case for blockquotes, etc.)
-  if (str.size() == 1)
-    return string(amount, str[0]);
+  for (const char *line = data, *end = data + len; line < end;) {
+    const char *line_end =
+        static_cast<const char *>(memchr(line, '\n', end - line));
+    if (line_end == nullptr)
+      line_end = end;
 
-  // For multi-character strings, reserve space upfront
+    // Same check as in TidyLines
+    if (line_end - line >= 3 && (line[0] == '`' || line[0] == '~') &&
+        line[1] == line[0] && line[2] == line[0])
+      toggles = !toggles;
+
+    line = line_end + 1;
+  }
+
+  return toggles;
+}
+
+vector<size_t> CleanUpCuts(const string &md, size_t parts, size_t min_part) {
+  vector<size_t> cuts = {0};
+  if (parts > 1)
+    min_part = std::max(min_part, md.size() / parts);
+
+  const char *data = md.data();
+  size_t pos = min_part;
+
+  while (pos < md.size()) {
+    const char *newline =
+        static_cast<const char *>(memchr(data + pos, '\n', md.size() - pos));
+    if (newline == nullptr)
+      break;
+
+    pos = newline - data + 1;
+    if (pos < md.size() && IsAsciiAlnum(data[pos])) {
+      cuts.push_back(pos);
+      pos += min_part;
+    }
+  }
+
+  cuts.push_back(md.size());
+  return cuts;
+}
+
+size_t DecodeEntities(
+    string *md, const std::unordered_map<string, string> &conversions) {
+  string buffer;
+  buffer.reserve(md->size());
+  size_t entities_decoded = 0;
+
+  for (size_t i = 0; i < md->size();) {
+    bool replaced = false;
+
+    // C++11 compatible iteration over the conversions
+    for (const auto &symbol_replacement : conversions) {
+      const string &symbol = symbol_replacement.first;
+      const string &replacement = symbol_replacement.second;
+
+      if (md->compare(i, symbol.size(), symbol) == 0) {
+        buffer.append(replacement);
+        i += symbol.size();
+        ++entities_decoded;
+        replaced = true;
+        break;
+      }
+    }
+
+    if (!replaced) {
+      buffer.push_back((*md)[i++]);
+    }
+  }
+
+  // Use swap instead of move assignment for better pre-C++11 compatibility
+  md->swap(buffer);
+
+  return entities_decoded;
+}
+
+void ReplaceLeftovers(string *md) {
+  // Optimized replacement sequence
+  // Note: Multiple simple passes are faster than one complex pass due to:
+  // - Better branch prediction
+  // - Better cache locality
+  // - Simpler instruction patterns
+  const char *replacements[][2] = {
+      {" , ", ", "},   {"\n.\n", ".\n"},   {"\n↵\n", " ↵\n"}, {"\n*\n", "\n"},
+      {"\n. ", ".\n"}, {"\t\t  ", "\t\t"},
+  };
+
+  for (const auto &replacement : replacements) {
+    ReplaceAll(md, replacement[0], replacement[1]);
+  }
+}
+
+bool WrapLines(string *md, size_t soft_break, size_t hard_break) {
+  const string &in = *md;
+  const size_t size = in.size();
+
+  // Only built once the first line is broken
   string out;
-  out.reserve(str.size() * amount);
-  for (size_t i = 0; i < amount; ++i)
-    out.append(str);
+  size_t copied = 0;
+
+  // The open code fence: its char, length and blockquote depth
+  char fence = 0;
+  size_t fence_len = 0;
+  size_t fence_quotes = 0;
+
+  bool in_table = false; // Between the delimiter row of a table and a blank line
+  string prefix;         // Inserted after every break of the current line
+
+  vector<size_t> link_openers; // See FindLinkOpeners(), reused for all lines
+  vector<size_t> open_brackets;
+
+  // When in doubt a line is left alone, not breaking it is always safe
+  auto lineEnd = [&](size_t start) -> size_t {
+    const void *nl = memchr(in.data() + start, '\n', size - start);
+    return nl != nullptr ? static_cast<const char *>(nl) - in.data() : size;
+  };
+
+  for (size_t line = 0; line < size;) {
+    const size_t eol = lineEnd(line);
+    const size_t next = eol + 1;
+
+    // Skip the blockquote markers and the indentation
+    size_t pos = line;
+    size_t quotes = 0;
+    while (pos < eol && in[pos] == '>') {
+      ++quotes;
+      ++pos;
+      if (pos < eol && in[pos] == ' ')
+        ++pos;
+    }
+    const size_t quote_end = pos;
+    bool has_tab = false;
+    while (pos < eol && (in[pos] == ' ' || in[pos] == '\t')) {
+      has_tab |= in[pos] == '\t';
+      ++pos;
+    }
+    const size_t indent = pos - quote_end;
+
+    size_t run = 0;
+    if (pos < eol && (in[pos] == '`' || in[pos] == '~'))
+      while (pos + run < eol && in[pos + run] == in[pos])
+        ++run;
+
+    if (fence != 0) {
+      // Closed by a run of at least the same length with nothing after it,
+      // or by the end of the blockquote it is in
+      size_t end = pos + run;
+      while (end < eol && in[end] == ' ')
+        ++end;
+      if (quotes < fence_quotes ||
+          (in[pos] == fence && run >= fence_len && end == eol))
+        fence = 0;
+
+      line = next;
+      continue;
+    }
+
+    // A fence may also open a list item
+    const size_t marker = ListMarkerWidth(in.data() + pos, eol - pos);
+    const size_t opening = pos + marker;
+    if (marker != 0) {
+      run = 0;
+      if (in[opening] == '`' || in[opening] == '~')
+        while (opening + run < eol && in[opening + run] == in[opening])
+          ++run;
+    }
+
+    // The info string of a backtick fence can't contain backticks
+    if (run >= 3 &&
+        (in[opening] == '~' || memchr(in.data() + opening + run, '`',
+                                      eol - opening - run) == nullptr)) {
+      fence = in[opening];
+      fence_len = run;
+      fence_quotes = quotes;
+      line = next;
+      continue;
+    }
+
+    if (pos == eol) {
+      in_table = false;
+      line = next;
+      continue;
+    }
+
+    // Every line after the delimiter row is a table row, with or without '|'
+    if (in_table || in[pos] == '|') {
+      in_table |= IsTableDelimiterRow(in.data() + pos, eol - pos);
+      line = next;
+      continue;
+    }
+
+    // A line can't be wider than it is long, so most lines are skipped
+    // without looking at their content. Breaking the line before a table
+    // delimiter row would change the header of the table, breaking a line of
+    // an HTML block could end the block.
+    if (eol - line <= soft_break || in[pos] == '#' ||
+        StartsHtmlBlock(in.data() + pos, eol - pos) ||
+        (next < size &&
+         IsTableDelimiterRow(in.data() + next, lineEnd(next) - next))) {
+      line = next;
+      continue;
+    }
+
+    // Continuation lines of a list item are indented to its text, indented
+    // code (4 spaces or a tab, outside of a list item) is left alone
+    if (marker == 0 && (has_tab || indent >= 4)) {
+      line = next;
+      continue;
+    }
+
+    prefix.assign(in, line, pos - line);
+    prefix.append(marker, ' ');
+
+    pos += marker;
+    const size_t content = pos;
+    size_t width = pos - line;
+    size_t last_space = string::npos;
+    size_t width_after_last_space = 0;
+
+    // The last space in a link, only broken at if the line would be wider
+    // than hard_break otherwise
+    size_t link_space = string::npos;
+    size_t width_after_link_space = 0;
+
+    // Is the line so far only made of '=', '-', '*', '_' and spaces? Breaking
+    // it there would turn it into a setext underline or thematic break.
+    bool only_rule_chars = true;
+
+    int brackets = 0;    // Depth of [link text]
+    int parens = 0;      // Depth of (link destination)
+    size_t code_run = 0; // Length of the backtick run opening a code span
+
+    // Only a '[' that opens a link keeps the line from being broken, text
+    // like "[sic" doesn't
+    link_openers.clear();
+    if (memchr(in.data() + content, '[', eol - content) != nullptr)
+      FindLinkOpeners(in.data() + content, eol - content, &link_openers,
+                      &open_brackets);
+    size_t next_opener = 0;
+
+    auto breakAt = [&](size_t space) {
+      out.append(in, copied, space - copied);
+      out += '\n';
+      out += prefix;
+      copied = space + 1;
+      only_rule_chars = false;
+      last_space = string::npos;
+      link_space = string::npos;
+    };
+
+    while (pos < eol) {
+      const unsigned char ch = static_cast<unsigned char>(in[pos]);
+
+      if (ch != '=' && ch != '-' && ch != '*' && ch != '_' && ch != ' ')
+        only_rule_chars = false;
+
+      if (ch >= 0x80) {
+        size_t len;
+        width += DisplayWidth(reinterpret_cast<const unsigned char *>(
+                                  in.data() + pos),
+                              eol - pos, &len);
+        pos += len;
+      } else if (ch == '`') {
+        size_t run = 1;
+        while (pos + run < eol && in[pos + run] == '`')
+          ++run;
+
+        if (code_run == 0)
+          code_run = run;
+        else if (code_run == run)
+          code_run = 0;
+
+        width += run;
+        pos += run;
+      } else if (code_run != 0) {
+        ++width;
+        ++pos;
+      } else if (ch == '\\' && pos + 1 < eol) {
+        width += 2;
+        pos += 2;
+      } else if (ch == ' ' && !only_rule_chars && in[pos - 1] != ' ' &&
+                 pos + 1 < eol && in[pos + 1] != ' ' &&
+                 !StartsBlock(in.data() + pos + 1, eol - pos - 1)) {
+        if (brackets != 0 || parens != 0) {
+          link_space = pos;
+          width_after_link_space = ++width;
+        } else if (width >= soft_break) {
+          breakAt(pos);
+          width = prefix.size();
+        } else {
+          last_space = pos;
+          width_after_last_space = ++width;
+        }
+        ++pos;
+        continue;
+      } else {
+        while (next_opener < link_openers.size() &&
+               content + link_openers[next_opener] < pos)
+          ++next_opener;
+
+        if (ch == '[') {
+          if (brackets > 0 || (next_opener < link_openers.size() &&
+                               content + link_openers[next_opener] == pos))
+            ++brackets;
+        } else if (ch == ']' && brackets > 0 && --brackets == 0 &&
+                   pos + 1 < eol && in[pos + 1] == '(') {
+          parens = -1; // Opened by the next char
+        } else if (ch == ']' && brackets == 0 && pos + 1 < eol &&
+                   in[pos + 1] == ':' && in[content] == '[') {
+          break; // Probably a link reference definition, leave the rest
+        } else if (ch == '(' && parens != 0) {
+          parens = parens < 0 ? 1 : parens + 1;
+        } else if (ch == ')' && parens > 0) {
+          --parens;
+        }
+
+        ++width;
+        ++pos;
+      }
+
+      // No space after the soft break, go back to the last one. Within a
+      // link if there is no other, hard_break is a hard limit.
+      if (width > hard_break && last_space != string::npos) {
+        width = prefix.size() + width - width_after_last_space;
+        breakAt(last_space);
+      } else if (width > hard_break && link_space != string::npos) {
+        width = prefix.size() + width - width_after_link_space;
+        breakAt(link_space);
+      }
+    }
+
+    line = next;
+  }
+
+  if (copied == 0)
+    return fence != 0;
+
+  out.append(in, copied, string::npos);
+  md->swap(out);
+  return fence != 0;
+}
+
+string ExtractAttribute(const char *tag, size_t tag_len, const string &attr) {
+  // locate given attribute (case-insensitive)
+  size_t offset_attr = FindCaseInsensitive(tag, tag_len, attr);
+
+  if (offset_attr == string::npos)
+    return "";
+
+  // locate attribute-value pair's '='
+  auto *equals = static_cast<const char *>(
+      memchr(tag + offset_attr, '=', tag_len - offset_attr));
+
+  if (equals == nullptr)
+    return "";
+
+  // locate value's surrounding quotes, whichever comes first
+  const char *end = tag + tag_len;
+  const char *opening_quote = equals;
+  while (opening_quote != end && *opening_quote != '"' &&
+         *opening_quote != '\'')
+    ++opening_quote;
+
+  if (opening_quote == end)
+    return "";
+
+  auto *closing_quote = static_cast<const char *>(
+      memchr(opening_quote + 1, *opening_quote, end - opening_quote - 1));
+
+  if (closing_quote == nullptr)
+    return "";
+
+  return string(opening_quote + 1, closing_quote);
+}
+
+} // namespace detail
+
+Converter::Converter(const string *html, Options *options) : html_(*html) {
+  if (options)
+    option = *options;
+
+  estimated_md_size_ = EstimateMarkdownSize(html->data(), html->size());
+  md_.reserve(estimated_md_size_);
+}
+
+const Converter::TagMap &Converter::Tags() {
+  static const TagMap tags = [] {
+    TagMap tags;
+    tags.reserve(41);
+
+    // non-printing tags
+    auto tagIgnored = make_shared<Converter::TagIgnored>();
+    tags[kTagHead] = tagIgnored;
+    tags[kTagMeta] = tagIgnored;
+    tags[kTagNav] = tagIgnored;
+    tags[kTagNoScript] = tagIgnored;
+    tags[kTagScript] = tagIgnored;
+    tags[kTagStyle] = tagIgnored;
+    tags[kTagTemplate] = tagIgnored;
+
+    // printing tags
+    tags[kTagAnchor] = make_shared<Converter::TagAnchor>();
+    tags[kTagBreak] = make_shared<Converter::TagBreak>();
+    tags[kTagDiv] = make_shared<Converter::TagDiv>();
+    tags[kTagHeader1] = make_shared<Converter::TagHeader1>();
+    tags[kTagHeader2] = make_shared<Converter::TagHeader2>();
+    tags[kTagHeader3] = make_shared<Converter::TagHeader3>();
+    tags[kTagHeader4] = make_shared<Converter::TagHeader4>();
+    tags[kTagHeader5] = make_shared<Converter::TagHeader5>();
+    tags[kTagHeader6] = make_shared<Converter::TagHeader6>();
+    tags[kTagListItem] = make_shared<Converter::TagListItem>();
+    tags[kTagOption] = make_shared<Converter::TagOption>();
+    tags[kTagOrderedList] = make_shared<Converter::TagOrderedList>();
+    tags[kTagPre] = make_shared<Converter::TagPre>();
+    tags[kTagCode] = make_shared<Converter::TagCode>();
+    tags[kTagParagraph] = make_shared<Converter::TagParagraph>();
+    tags[kTagSpan] = make_shared<Converter::TagSpan>();
+    tags[kTagUnorderedList] = make_shared<Converter::TagUnorderedList>();
+    tags[kTagTitle] = make_shared<Converter::TagTitle>();
+    tags[kTagImg] = make_shared<Converter::TagImage>();
+    tags[kTagSeperator] = make_shared<Converter::TagSeperator>();
+
+    // Text formatting
+    auto tagBold = make_shared<Converter::TagBold>();
+    tags[kTagBold] = tagBold;
+    tags[kTagStrong] = tagBold;
+
+    auto tagItalic = make_shared<Converter::TagItalic>();
+    tags[kTagItalic] = tagItalic;
+    tags[kTagItalic2] = tagItalic;
+    tags[kTagDefinition] = tagItalic;
+    tags[kTagCitation] = tagItalic;
+
+    tags[kTagUnderline] = make_shared<Converter::TagUnderline>();
+
+    auto tagStrighthrought = make_shared<Converter::TagStrikethrought>();
+    tags[kTagStrighthrought] = tagStrighthrought;
+    tags[kTagStrighthrought2] = tagStrighthrought;
+
+    tags[kTagBlockquote] = make_shared<Converter::TagBlockquote>();
+
+    // Tables
+    tags[kTagTable] = make_shared<Converter::TagTable>();
+    tags[kTagTableRow] = make_shared<Converter::TagTableRow>();
+    tags[kTagTableHeader] = make_shared<Converter::TagTableHeader>();
+    tags[kTagTableData] = make_shared<Converter::TagTableData>();
+
+    return tags;
+  }();
+
+  return tags;
+}
+
+void Converter::CleanUpMarkdown() {
+  if (!CleanUpMarkdownInParallel()) {
+    {
+      ScopedTimer timer(stats_ ? &stats_->tidyNs : nullptr);
+      HTML2MD_TRACE_SCOPE(kTidy, "");
+      detail::TidyAllLines(&md_, option.forceLeftTrim);
+    }
+
+    {
+      ScopedTimer timer(stats_ ? &stats_->entitiesNs : nullptr);
+      HTML2MD_TRACE_SCOPE(kEntities, "");
+      size_t entities_decoded = 0;
+
+      // Replace HTML symbols unless the user requested to keep HTML entities
+      // intact (e.g. keep `&nbsp;`)
+      if (!option.keepHtmlEntities)
+        entities_decoded =
+            detail::DecodeEntities(&md_, htmlSymbolConversions_);
+
+      if (stats_) {
+        stats_->entitiesDecoded += entities_decoded;
+        if (!option.keepHtmlEntities)
+          ++stats_->reallocations; // md_ was replaced by a new buffer
+      }
+    }
+
+    {
+      ScopedTimer timer(stats_ ? &stats_->replaceNs : nullptr);
+      HTML2MD_TRACE_SCOPE(kReplace, "");
+      detail::ReplaceLeftovers(&md_);
+    }
+  }
 
-  return out;
+  if (option.splitLines) {
+    ScopedTimer timer(stats_ ? &stats_->wrapNs : nullptr);
+    HTML2MD_TRACE_SCOPE(kWrap, "");
+    detail::WrapLines(&md_, static_cast<size_t>(std::max(option.softBreak, 0)),
+                      static_cast<size_t>(std::max(option.hardBreak, 0)));
+  }
+
+  // Remove trailing double newline if present (keep only single newline)
+  if (md_.size() >= 2 && md_[md_.size() - 1] == '\n' && md_[md_.size() - 2] == '\n') {
+    md_.pop_back();
+  }
 }
 
-string toLower(const string &str) {
-  string lower;
-  lower.reserve(str.size());
-  for (char ch : str) {
-    lower += tolower(ch);
+bool Converter::SymbolsStayWithinLines() const {
+  if (option.keepHtmlEntities)
+    return true;
+
+  for (const auto &conversion : htmlSymbolConversions_) {
+    const string &symbol = conversion.first;
+    if (symbol.empty() || IsAsciiAlnum(symbol[0]) ||
+        symbol.find('\n') != string::npos)
+      return false;
   }
-  return lower;
+
+  return true;
 }
 
-} // namespace
+bool Converter::CleanUpMarkdownInParallel() {
+  const size_t threads = ThreadCount(option.threads);
+  if (threads < 2 || md_.size() < 2 * kMinCleanUpPart)
+    return false;
 
-namespace html2md {
+  // The parts are only independent if no symbol matches across a line start
+  if (!SymbolsStayWithinLines())
+    return false;
 
-Converter::Converter(const string *html, Options *options) : html_(*html) {
-  if (options)
-    option = *options;
+  // Like TidyAllLines(), so every part ends with a newline
+  if (md_.back() != '\n')
+    md_.push_back('\n');
 
-  md_.reserve(html->size() * 1.2);
-  tags_.reserve(41);
-
-  // non-printing tags
-  auto tagIgnored = make_shared<Converter::TagIgnored>();
-  tags_[kTagHead] = tagIgnored;
-  tags_[kTagMeta] = tagIgnored;
-  tags_[kTagNav] = tagIgnored;
-  tags_[kTagNoScript] = tagIgnored;
-  tags_[kTagScript] = tagIgnored;
-  tags_[kTagStyle] = tagIgnored;
-  tags_[kTagTemplate] = tagIgnored;
-
-  // printing tags
-  tags_[kTagAnchor] = make_shared<Converter::TagAnchor>();
-  tags_[kTagBreak] = make_shared<Converter::TagBreak>();
-  tags_[kTagDiv] = make_shared<Converter::TagDiv>();
-  tags_[kTagHeader1] = make_shared<Converter::TagHeader1>();
-  tags_[kTagHeader2] = make_shared<Converter::TagHeader2>();
-  tags_[kTagHeader3] = make_shared<Converter::TagHeader3>();
-  tags_[kTagHeader4] = make_shared<Converter::TagHeader4>();
-  tags_[kTagHeader5] = make_shared<Converter::TagHeader5>();
-  tags_[kTagHeader6] = make_shared<Converter::TagHeader6>();
-  tags_[kTagListItem] = make_shared<Converter::TagListItem>();
-  tags_[kTagOption] = make_shared<Converter::TagOption>();
-  tags_[kTagOrderedList] = make_shared<Converter::TagOrderedList>();
-  tags_[kTagPre] = make_shared<Converter::TagPre>();
-  tags_[kTagCode] = make_shared<Converter::TagCode>();
-  tags_[kTagParagraph] = make_shared<Converter::TagParagraph>();
-  tags_[kTagSpan] = make_shared<Converter::TagSpan>();
-  tags_[kTagUnorderedList] = make_shared<Converter::TagUnorderedList>();
-  tags_[kTagTitle] = make_shared<Converter::TagTitle>();
-  tags_[kTagImg] = make_shared<Converter::TagImage>();
-  tags_[kTagSeperator] = make_shared<Converter::TagSeperator>();
-
-  // Text formatting
-  auto tagBold = make_shared<Converter::TagBold>();
-  tags_[kTagBold] = tagBold;
-  tags_[kTagStrong] = tagBold;
-
-  auto tagItalic = make_shared<Converter::TagItalic>();
-  tags_[kTagItalic] = tagItalic;
-  tags_[kTagItalic2] = tagItalic;
-  tags_[kTagDefinition] = tagItalic;
-  tags_[kTagCitation] = tagItalic;
-
-  tags_[kTagUnderline] = make_shared<Converter::TagUnderline>();
-
-  auto tagStrighthrought = make_shared<Converter::TagStrikethrought>();
-  tags_[kTagStrighthrought] = tagStrighthrought;
-  tags_[kTagStrighthrought2] = tagStrighthrought;
-
-  tags_[kTagBlockquote] = make_shared<Converter::TagBlockquote>();
-
-  // Tables
-  tags_[kTagTable] = make_shared<Converter::TagTable>();
-  tags_[kTagTableRow] = make_shared<Converter::TagTableRow>();
-  tags_[kTagTableHeader] = make_shared<Converter::TagTableHeader>();
-  tags_[kTagTableData] = make_shared<Converter::TagTableData>();
-}
+  const vector<size_t> cuts = detail::CleanUpCuts(md_, threads, kMinCleanUpPart);
+  const size_t parts = cuts.size() - 1;
+  if (parts < 2)
+    return false;
 
-void Converter::CleanUpMarkdown() {
-  TidyAllLines(&md_);
-  std::string buffer;
-  buffer.reserve(md_.size());
-
-  // Replace HTML symbols during the initial pass unless the user requested
-  // to keep HTML entities intact (e.g. keep `&nbsp;`)
-  if (!option.keepHtmlEntities) {
-    for (size_t i = 0; i < md_.size();) {
-      bool replaced = false;
-
-      // C++11 compatible iteration over htmlSymbolConversions_
-      for (const auto &symbol_replacement : htmlSymbolConversions_) {
-        const std::string &symbol = symbol_replacement.first;
-        const std::string &replacement = symbol_replacement.second;
-
-        if (md_.compare(i, symbol.size(), symbol) == 0) {
-          buffer.append(replacement);
-          i += symbol.size();
-          replaced = true;
-          break;
-        }
-      }
+  vector<string> cleaned(parts);
+
+  {
+    ScopedTimer timer(stats_ ? &stats_->tidyNs : nullptr);
+    HTML2MD_TRACE_SCOPE(kTidy, "");
+    char *data = &md_[0];
+
+    // Whether a part starts inside a code block depends on all parts before
+    vector<char> in_code_block(parts, false);
+    detail::RunConcurrently(parts, [&](size_t i) {
+      in_code_block[i] =
+          detail::TogglesCodeBlock(data + cuts[i], cuts[i + 1] - cuts[i]);
+    });
+    bool in_code = false;
+    for (size_t i = 0; i < parts; ++i) {
+      const bool toggles = in_code_block[i] != 0;
+      in_code_block[i] = in_code;
+      in_code = in_code != toggles;
+    }
+
+    detail::RunConcurrently(parts, [&](size_t i) {
+      const size_t len =
+          detail::TidyLines(data + cuts[i], cuts[i + 1] - cuts[i],
+                            option.forceLeftTrim, in_code_block[i] != 0);
+      cleaned[i].assign(data + cuts[i], len);
+    });
+  }
 
-      if (!replaced) {
-        buffer.push_back(md_[i++]);
+  {
+    ScopedTimer timer(stats_ ? &stats_->entitiesNs : nullptr);
+    HTML2MD_TRACE_SCOPE(kEntities, "");
+
+    if (!option.keepHtmlEntities) {
+      vector<size_t> entities_decoded(parts, 0);
+      detail::RunConcurrently(parts, [&](size_t i) {
+        entities_decoded[i] =
+            detail::DecodeEntities(&cleaned[i], htmlSymbolConversions_);
+      });
+
+      if (stats_) {
+        for (size_t decoded : entities_decoded)
+          stats_->entitiesDecoded += decoded;
       }
     }
-  } else {
-    // Keep entities as-is: copy through without transforming
-    buffer.append(md_);
   }
 
-  // Use swap instead of move assignment for better pre-C++11 compatibility
-  md_.swap(buffer);
+  {
+    ScopedTimer timer(stats_ ? &stats_->replaceNs : nullptr);
+    HTML2MD_TRACE_SCOPE(kReplace, "");
+    detail::RunConcurrently(parts,
+                    [&](size_t i) { detail::ReplaceLeftovers(&cleaned[i]); });
 
-  // Optimized replacement sequence
-  // Note: Multiple simple passes are faster than one complex pass due to:
-  // - Better branch prediction
-  // - Better cache locality
-  // - Simpler instruction patterns
-  const char *replacements[][2] = {
-      {" , ", ", "},   {"\n.\n", ".\n"},   {"\n↵\n", " ↵\n"}, {"\n*\n", "\n"},
-      {"\n. ", ".\n"}, {"\t\t  ", "\t\t"},
-  };
+    vector<size_t> offsets(parts + 1, 0);
+    for (size_t i = 0; i < parts; ++i)
+      offsets[i + 1] = offsets[i] + cleaned[i].size();
 
-  for (const auto &replacement : replacements) {
-    ReplaceAll(&md_, replacement[0], replacement[1]);
+    if (stats_ && offsets[parts] > md_.capacity())
+      ++stats_->reallocations;
+
+    md_.resize(offsets[parts]);
+    char *data = &md_[0];
+    detail::RunConcurrently(parts, [&](size_t i) {
+      memcpy(data + offsets[i], cleaned[i].data(), cleaned[i].size());
+    });
   }
+
+  return true;
 }
 
 Converter *Converter::appendToMd(char ch) {
@@ -235,20 +1235,22 @@ Converter *Converter::appendToMd(char ch) {
 }
 
 Converter *Converter::appendToMd(const char *str) {
+  return appendToMd(str, strlen(str));
+}
+
+Converter *Converter::appendToMd(const char *str, size_t size) {
   if (IsInIgnoredTag())
     return this;
 
-  md_ += str;
+  md_.append(str, size);
 
-  auto str_len = strlen(str);
-  
-  // Efficiently update chars_in_curr_line_ by scanning for last newline
-  for (size_t i = 0; i < str_len; ++i) {
-    if (str[i] == '\n')
-      chars_in_curr_line_ = 0;
-    else
-      ++chars_in_curr_line_;
-  }
+  // Only the chars after the last newline are in the current line
+  size_t line = size;
+  while (line > 0 && str[line - 1] != '\n')
+    --line;
+
+  chars_in_curr_line_ =
+      line > 0 ? size - line : chars_in_curr_line_ + size;
 
   return this;
 }
@@ -300,223 +1302,430 @@ Converter *Converter::Trim(string *s) {
   return this;
 }
 
-void Converter::TidyAllLines(string *str) {
-  if (str->empty())
-    return;
+string Converter::ExtractAttributeFromTagLeftOf(const string &attr) {
+  // Search the raw tag instead of copying and lowercasing it first
+  return detail::ExtractAttribute(raw_tag_.data(), raw_tag_.size(), attr);
+}
 
-  // Ensure input ends with newline to simplify logic
-  if (str->back() != '\n') {
-    str->push_back('\n');
-  }
+void Converter::TurnLineIntoHeader1() {
+  appendToMd('\n' + Repeat("=", chars_in_curr_line_) + "\n\n");
 
-  size_t read = 0;
-  size_t write = 0;
-  size_t len = str->size();
+  chars_in_curr_line_ = 0;
+}
 
-  uint8_t amount_newlines = 0;
-  bool in_code_block = false;
+void Converter::TurnLineIntoHeader2() {
+  appendToMd('\n' + Repeat("-", chars_in_curr_line_) + "\n\n");
 
-  while (read < len) {
-    size_t line_start = read;
-    size_t line_end = read;
+  chars_in_curr_line_ = 0;
+}
 
-    // Find end of line
-    while (line_end < len && (*str)[line_end] != '\n') {
-      line_end++;
-    }
+string Converter::convert() {
+  ConvertHtml();
 
-    size_t line_len = line_end - line_start;
+  return md_;
+}
 
-    // Check for code block markers
-    if (line_len >= 3) {
-      char c1 = (*str)[line_start];
-      char c2 = (*str)[line_start + 1];
-      char c3 = (*str)[line_start + 2];
-      if ((c1 == '`' && c2 == '`' && c3 == '`') ||
-          (c1 == '~' && c2 == '~' && c3 == '~')) {
-        in_code_block = !in_code_block;
-      }
-    }
+string Converter::convert(ConversionStats *stats) {
+  stats_ = stats;
+  ConvertHtml();
+  stats_ = nullptr;
 
-    if (in_code_block) {
-      // Copy line as-is
-      if (write != line_start) {
-        for (size_t i = 0; i < line_len; ++i) {
-          (*str)[write + i] = (*str)[line_start + i];
-        }
-      }
-      write += line_len;
-      (*str)[write++] = '\n';
-    } else {
-      // Trim logic
-      size_t trim_start = line_start;
-      size_t trim_end = line_end;
+  if (stats != nullptr) {
+    stats->inputBytes = html_.size();
+    stats->outputBytes = md_.size();
+    stats->estimatedOutputBytes = estimated_md_size_;
+  }
 
-      // Trim leading whitespace
-      if (option.forceLeftTrim ||
-          (trim_start < trim_end && (*str)[trim_start] != '\t')) {
-        while (trim_start < trim_end &&
-               std::isspace((unsigned char)(*str)[trim_start])) {
-          ++trim_start;
-        }
-      }
+  return md_;
+}
 
-      // Trim trailing whitespace, preserve "  "
-      bool has_line_break = false;
-      if (trim_end >= trim_start + 2 && (*str)[trim_end - 1] == ' ' &&
-          (*str)[trim_end - 2] == ' ') {
-        has_line_break = true;
-        trim_end -= 2;
-      }
+void Converter::ConvertHtml() {
+  // We already converted
+  if (index_ch_in_html_ == html_.size())
+    return;
 
-      while (trim_end > trim_start &&
-             std::isspace((unsigned char)(*str)[trim_end - 1])) {
-        --trim_end;
-      }
+  reset();
 
-      if (has_line_break) {
-        trim_end += 2;
-      }
+  HTML2MD_TRACE_SCOPE(kConvert, "");
 
-      size_t trimmed_len = trim_end - trim_start;
+  if (stats_ == nullptr) {
+    {
+      HTML2MD_TRACE_SCOPE(kTokenize, "");
+      if (!TokenizeInParallel())
+        Tokenize(html_.data(), html_.size());
+    }
 
-      if (trimmed_len == 0) {
-        // Empty line
-        if (amount_newlines < 2 && write > 0) {
-          (*str)[write++] = '\n';
-          amount_newlines++;
-        }
-      } else {
-        amount_newlines = 0;
-        if (write != trim_start) {
-          for (size_t i = 0; i < trimmed_len; ++i) {
-            (*str)[write + i] = (*str)[trim_start + i];
-          }
-        }
-        write += trimmed_len;
-        (*str)[write++] = '\n';
+    CleanUpMarkdown();
+  } else {
+    *stats_ = ConversionStats();
+    ScopedTimer total_timer(&stats_->totalNs);
+
+    {
+      ScopedTimer timer(&stats_->tokenizeNs);
+      HTML2MD_TRACE_SCOPE(kTokenize, "");
+      const size_t capacity = md_.capacity();
+
+      // Tokenize all of the HTML at once like without stats, so only whether
+      // md_ outgrew the estimate is known, not how often it grew
+      if (!TokenizeInParallel()) {
+        Tokenize(html_.data(), html_.size());
+
+        if (md_.capacity() != capacity)
+          ++stats_->reallocations;
       }
     }
+    // Tables are formatted while tokenizing. In parallel tableNs is the sum of
+    // all threads, so it can exceed the time spent tokenizing.
+    stats_->tokenizeNs -= std::min(stats_->tokenizeNs, stats_->tableNs);
 
-    read = line_end + 1;
+    CleanUpMarkdown();
+  }
+}
+
+void Converter::feed(const char *data, size_t size) {
+  if (!is_fed_) {
+    reset();
+    is_fed_ = true;
+    flush_scanned_ = 0;
+    flush_in_code_ = false;
+    Tokenize(html_.data(), html_.size());
   }
 
-  str->resize(write);
+  // Reserve for the chunk like the constructor does for the whole HTML, but
+  // at least doubling, so many small chunks don't reallocate md_ every time
+  const size_t needed = md_.size() + EstimateMarkdownSize(data, size);
+  if (needed > md_.capacity())
+    md_.reserve(std::max(needed, 2 * md_.capacity()));
+
+  Tokenize(data, size);
+}
+
+string Converter::flush() {
+  if (!is_fed_ || !SymbolsStayWithinLines())
+    return string();
+
+  // Only the last paragraph can still change, as can a table that is open.
+  // The last paragraph starts after the last blank line.
+  size_t limit = md_.size();
+  while (limit > 2 && !(md_[limit - 1] == '\n' && md_[limit - 2] == '\n' &&
+                        limit < md_.size() && md_[limit] != '\n'))
+    --limit;
+  if (limit <= 2)
+    return string();
+  limit -= 2;
+  if (index_table != 0)
+    limit = std::min(limit, table_start);
+
+  // Cut before the last line that follows a blank line, starts with an ASCII
+  // letter or digit and isn't in a code block. The Markdown can be cleaned up
+  // in parts cut there, see detail::CleanUpCuts().
+  const char *data = md_.data();
+  size_t cut = 0;
+  for (size_t line = flush_scanned_; line < limit;) {
+    const void *newline = memchr(data + line, '\n', limit - line);
+    if (newline == nullptr)
+      break;
+    const size_t next = static_cast<const char *>(newline) - data + 1;
+
+    if (!flush_in_code_ && line >= 2 && data[line - 1] == '\n' &&
+        data[line - 2] == '\n' && IsAsciiAlnum(data[line]))
+      cut = line;
+
+    flush_in_code_ =
+        flush_in_code_ != detail::TogglesCodeBlock(data + line, next - line);
+    flush_scanned_ = line = next;
+  }
+
+  if (cut == 0)
+    return string();
+
+  string part(md_, 0, cut);
+  part.resize(
+      detail::TidyLines(&part[0], part.size(), option.forceLeftTrim, false));
+  if (!option.keepHtmlEntities)
+    detail::DecodeEntities(&part, htmlSymbolConversions_);
+  detail::ReplaceLeftovers(&part);
+
+  // WrapLines() sees more fences than TidyLines(), the part must not end in
+  // one of them
+  if (option.splitLines &&
+      detail::WrapLines(&part,
+                        static_cast<size_t>(std::max(option.softBreak, 0)),
+                        static_cast<size_t>(std::max(option.hardBreak, 0))))
+    return string();
+
+  // Drop the part, the offsets into md_ move with it
+  md_.erase(0, cut);
+  auto move = [cut](size_t *offset) {
+    *offset = *offset > cut ? *offset - cut : 0;
+  };
+  move(&flush_scanned_);
+  move(&table_start);
+  move(&no_space_end_);
+  move(&md_low_water_);
+  move(&last_text_end_);
+  if (line_start_amp_ != string::npos)
+    line_start_amp_ = line_start_amp_ >= cut ? line_start_amp_ - cut
+                                             : string::npos;
+
+  return part;
 }
 
-string Converter::ExtractAttributeFromTagLeftOf(const string &attr) {
-  // Extract the whole tag from current offset, e.g. from '>', backwards
-  auto tag = html_.substr(offset_lt_, index_ch_in_html_ - offset_lt_);
-  string lowerTag = toLower(tag); // Convert tag to lowercase for comparison
+string Converter::finish() {
+  if (!is_fed_)
+    return convert();
 
-  // locate given attribute (case-insensitive)
-  auto offset_attr = lowerTag.find(attr);
+  is_fed_ = false;
+  CleanUpMarkdown();
 
-  if (offset_attr == string::npos)
-    return "";
+  return std::move(md_);
+}
 
-  // locate attribute-value pair's '='
-  auto offset_equals = tag.find('=', offset_attr);
+bool Converter::TokenizeInParallel() {
+  const size_t threads = ThreadCount(option.threads);
+  if (threads < 2 || html_.size() < 2 * kMinConvertPart)
+    return false;
 
-  if (offset_equals == string::npos)
-    return "";
+  const char *html = html_.data();
+  const size_t size = html_.size();
 
-  // locate value's surrounding quotes
-  auto offset_double_quote = tag.find('"', offset_equals);
-  auto offset_single_quote = tag.find('\'', offset_equals);
+  // Cut after the end of a block, where a conversion is likely in the same
+  // state no matter what came before
+  vector<size_t> cuts = {0};
+  const size_t step = std::max(size / threads, kMinConvertPart);
+  for (size_t from = step; from < size;) {
+    const size_t cut = FindBlockEnd(html, from, size);
+    if (cut == size)
+      break;
 
-  bool has_double_quote = offset_double_quote != string::npos;
-  bool has_single_quote = offset_single_quote != string::npos;
+    cuts.push_back(cut);
+    from = cut + step;
+  }
+  cuts.push_back(size);
 
-  if (!has_double_quote && !has_single_quote)
-    return "";
+  const size_t parts = cuts.size() - 1;
+  if (parts < 2)
+    return false;
 
-  char wrapping_quote = 0;
+  // Every part after the first is converted by its own Converter, which
+  // first converts the HTML just before the part. starts[i] is a copy of it
+  // at the start of the part.
+  const string no_html;
+  vector<Converter> converters;
+  vector<Converter> starts;
+  converters.reserve(parts);
+  starts.reserve(parts);
+  for (size_t i = 0; i < parts; ++i) {
+    converters.push_back(Converter(&no_html, &option));
+    starts.push_back(Converter(&no_html, &option));
+  }
+  vector<ConversionStats> part_stats(parts);
+  vector<char> failed(parts, false);
+
+  detail::RunConcurrently(parts, [&](size_t i) {
+    if (i == 0) {
+      Tokenize(html, cuts[1]);
+      return;
+    }
 
-  size_t offset_opening_quote = 0;
-  size_t offset_closing_quote = 0;
+    Converter &c = converters[i];
+    c.md_.reserve((cuts[i + 1] - cuts[i]) / 2);
 
-  if (has_double_quote) {
-    if (!has_single_quote) {
-      wrapping_quote = '"';
-      offset_opening_quote = offset_double_quote;
+    size_t warm_up = cuts[i];
+    for (size_t window = kWarmUp; warm_up == cuts[i]; window *= 4) {
+      const size_t from = cuts[i] - std::min(cuts[i], window);
+      warm_up = FindBlockEnd(html, from, cuts[i]);
+      if (warm_up == cuts[i] && (from == 0 || window >= kMaxWarmUp))
+        warm_up = from;
+    }
+
+    // Converting from a wrong state may throw where the serial conversion
+    // doesn't, the part is converted again then
+    try {
+      ConversionStats warm_up_stats;
+      c.stats_ = stats_ ? &warm_up_stats : nullptr;
+      c.Tokenize(html + warm_up, cuts[i] - warm_up);
+
+      starts[i] = c;
+      c.md_low_water_ = c.md_.size();
+      c.stats_ = stats_ ? &part_stats[i] : nullptr;
+      c.Tokenize(html + cuts[i], cuts[i + 1] - cuts[i]);
+    } catch (...) {
+      failed[i] = true;
+    }
+  });
+
+  // Join the parts. A part is taken if the conversion before it ended in the
+  // state it started with and it never looked at Markdown before its start,
+  // otherwise the conversion before it goes on over it.
+  string md;
+  md.reserve(md_.capacity());
+  Converter *current = this;
+  size_t current_start = 0;
+
+  for (size_t i = 1; i < parts; ++i) {
+    const Converter &start = starts[i];
+    Converter &next = converters[i];
+
+    if (!failed[i] && start.md_.size() >= 2 &&
+        next.md_low_water_ >= start.md_.size() &&
+        endsWith(current->md_, start.md_) && current->HasSameStateAs(start)) {
+      md.append(current->md_, current_start, string::npos);
+      if (stats_ && current != this)
+        AddPartStats(*current->stats_, stats_);
+
+      current = &next;
+      current_start = start.md_.size();
     } else {
-      if (offset_double_quote < offset_single_quote) {
-        wrapping_quote = '"';
-        offset_opening_quote = offset_double_quote;
-      } else {
-        wrapping_quote = '\'';
-        offset_opening_quote = offset_single_quote;
-      }
+      current->Tokenize(html + cuts[i], cuts[i + 1] - cuts[i]);
     }
-  } else {
-    // has only single quote
-    wrapping_quote = '\'';
-    offset_opening_quote = offset_single_quote;
   }
 
-  if (offset_opening_quote == string::npos)
-    return "";
+  md.append(current->md_, current_start, string::npos);
 
-  offset_closing_quote = tag.find(wrapping_quote, offset_opening_quote + 1);
+  // Go on with the state of the last conversion
+  if (current != this) {
+    if (stats_)
+      AddPartStats(*current->stats_, stats_);
 
-  if (offset_closing_quote == string::npos)
-    return "";
+    ConversionStats *stats = stats_;
+    const size_t estimated_md_size = estimated_md_size_;
+    string html_copy;
+    html_copy.swap(html_);
+    auto conversions = std::move(htmlSymbolConversions_);
 
-  return tag.substr(offset_opening_quote + 1,
-                    offset_closing_quote - 1 - offset_opening_quote);
-}
+    *this = std::move(*current);
 
-void Converter::TurnLineIntoHeader1() {
-  appendToMd('\n' + Repeat("=", chars_in_curr_line_) + "\n\n");
+    html_.swap(html_copy);
+    htmlSymbolConversions_ = std::move(conversions);
+    estimated_md_size_ = estimated_md_size;
+    stats_ = stats;
+  }
 
-  chars_in_curr_line_ = 0;
+  md_.swap(md);
+  index_ch_in_html_ = html_.size();
+  return true;
 }
 
-void Converter::TurnLineIntoHeader2() {
-  appendToMd('\n' + Repeat("-", chars_in_curr_line_) + "\n\n");
+bool Converter::HasSameStateAs(const Converter &other) const {
+  // ReplacePreviousSpaceInLineByNewline() searches back to the last newline
+  // or to no_space_end_, whichever comes first
+  auto searched = [](const Converter &c) {
+    const size_t newline = c.md_.rfind('\n');
+    return c.md_.size() -
+           std::max(c.no_space_end_, newline != string::npos ? newline : 0);
+  };
 
-  chars_in_curr_line_ = 0;
+  // Offsets into md_ differ, so table_start can't be compared: a part isn't
+  // taken inside a table
+  return !is_in_table_ && !other.is_in_table_ &&
+         searched(*this) == searched(other) &&
+         tokenizer_state_ == other.tokenizer_state_ &&
+         is_closing_tag_ == other.is_closing_tag_ &&
+         is_in_code_ == other.is_in_code_ &&
+         is_in_list_ == other.is_in_list_ && is_in_p_ == other.is_in_p_ &&
+         is_in_pre_ == other.is_in_pre_ &&
+         is_in_table_row_ == other.is_in_table_row_ &&
+         is_in_tag_ == other.is_in_tag_ &&
+         is_self_closing_tag_ == other.is_self_closing_tag_ &&
+         is_plain_text_ == other.is_plain_text_ &&
+         is_in_ordered_list_ == other.is_in_ordered_list_ &&
+         index_ol == other.index_ol && index_li == other.index_li &&
+         index_blockquote == other.index_blockquote &&
+         index_table == other.index_table &&
+         prev_ch_in_md_ == other.prev_ch_in_md_ &&
+         prev_prev_ch_in_md_ == other.prev_prev_ch_in_md_ &&
+         chars_in_curr_line_ == other.chars_in_curr_line_ &&
+         raw_tag_ == other.raw_tag_ && current_tag_ == other.current_tag_ &&
+         prev_tag_ == other.prev_tag_ && tableLine == other.tableLine &&
+         current_href_ == other.current_href_ &&
+         current_title_ == other.current_title_;
+}
+
+void Converter::Tokenize(const char *data, size_t size) {
+  // The option doesn't change during a conversion, so the kernel is chosen
+  // once per chunk instead of checking it for every char
+  if (option.compressWhitespace)
+    TokenizeWith<true>(data, size);
+  else
+    TokenizeWith<false>(data, size);
 }
 
-string Converter::convert() {
-  // We already converted
-  if (index_ch_in_html_ == html_.size())
-    return md_;
-
-  reset();
+template <bool kCompressWhitespace>
+void Converter::TokenizeWith(const char *data, size_t size) {
+  index_ch_in_html_ += size;
 
-  for (char ch : html_) {
-    ++index_ch_in_html_;
+  // With escapeMarkdown more chars of the text need a look
+  const uint8_t *classes =
+      option.escapeMarkdown ? kBytes.markdown_classes : kBytes.classes;
 
-    if (!is_in_tag_ && ch == '<') {
-      OnHasEnteredTag();
+  for (const char *ch = data, *end = data + size; ch != end; ++ch) {
+    const auto c =
+        static_cast<CharClass>(classes[static_cast<unsigned char>(*ch)]);
 
+    if (tokenizer_state_ != TokenizerState::kText) {
+      raw_tag_ += *ch;
+      ParseCharInTag(*ch);
       continue;
     }
 
-    if (is_in_tag_)
-      ParseCharInTag(ch);
-    else
-      ParseCharInTagContent(ch);
-  }
+    switch (c) {
+    case kClassLess:
+      OnHasEnteredTag();
+      break;
+    case kClassSpace:
+    case kClassNewline:
+      // A run of whitespace in text becomes a single space, none at the
+      // start or after a space or newline, as a browser shows it. Looking at
+      // the end of md_ is enough, tags write to it between the runs. In a
+      // blockquote ParseCharInTagContent() starts the next line with "> " at
+      // a newline, which keeps its paragraphs and list items apart.
+      if (kCompressWhitespace && is_plain_text_ && !is_in_pre_ &&
+          index_blockquote == 0 && IsHtmlSpace(*ch)) {
+        while (ch + 1 != end && IsHtmlSpace(ch[1]))
+          ++ch;
+
+        if (!md_.empty() && md_.back() != ' ' && md_.back() != '\n') {
+          md_ += ' ';
+          ++chars_in_curr_line_;
+          last_text_end_ = md_.length();
+        }
+        break;
+      }
 
-  CleanUpMarkdown();
+      ParseCharInTagContent<kCompressWhitespace>(*ch);
+      break;
+    case kClassEscape:
+      ParseCharInTagContent<kCompressWhitespace>(*ch);
+      break;
+    default:
+      if (!is_plain_text_) {
+        ParseCharInTagContent<kCompressWhitespace>(*ch);
+        break;
+      }
 
-  // Remove trailing double newline if present (keep only single newline)
-  if (md_.size() >= 2 && md_[md_.size() - 1] == '\n' && md_[md_.size() - 2] == '\n') {
-    md_.pop_back();
-  }
+      // Copy the run of chars that don't need escaping at once, the same as
+      // ParseCharInTagContent() does for each of them
+      const char *run = ch;
+      while (ch + 1 != end &&
+             IsVerbatimText(classes[static_cast<unsigned char>(ch[1])]))
+        ++ch;
 
-  return md_;
+      md_.append(run, ch + 1 - run);
+      chars_in_curr_line_ += ch + 1 - run;
+      last_text_end_ = md_.size();
+    }
+  }
 }
 
 void Converter::OnHasEnteredTag() {
-  offset_lt_ = index_ch_in_html_;
+  tokenizer_state_ = TokenizerState::kTagStart;
+  raw_tag_.clear();
   is_in_tag_ = true;
   is_closing_tag_ = false;
-  prev_tag_ = current_tag_;
-  current_tag_ = "";
+  // Swap instead of copying so both buffers keep their capacity
+  prev_tag_.swap(current_tag_);
+  current_tag_.clear();
 
   if (!md_.empty()) {
     UpdatePrevChFromMd();
@@ -534,57 +1743,80 @@ Converter *Converter::UpdatePrevChFromMd() {
   return this;
 }
 
-bool Converter::ParseCharInTag(char ch) {
-  static bool skipping_leading_whitespace = true;
+void Converter::ParseCharInTag(char ch) {
+  // Within a quoted attribute value everything up to the closing quote is part
+  // of the value, including '>' and '/'
+  if (tokenizer_state_ == TokenizerState::kDoubleQuotedValue ||
+      tokenizer_state_ == TokenizerState::kSingleQuotedValue) {
+    const char quote =
+        tokenizer_state_ == TokenizerState::kDoubleQuotedValue ? '"' : '\'';
 
-  if (ch == '/' && !is_in_attribute_value_) {
-    is_closing_tag_ = current_tag_.empty();
-    is_self_closing_tag_ = !is_closing_tag_;
-    skipping_leading_whitespace = true; // Reset for next tag
-    return true;
+    if (ch == quote)
+      tokenizer_state_ = TokenizerState::kTag;
+    else
+      current_tag_ += ToLower(ch);
+
+    return;
   }
 
-  if (ch == '>') {
+  switch (ClassOf(ch)) {
+  case kClassSlash:
+    is_closing_tag_ = current_tag_.empty();
+    is_self_closing_tag_ = !is_closing_tag_;
+    tokenizer_state_ = TokenizerState::kTagStart;
+    return;
+  case kClassGreater:
     // Trim trailing whitespace by removing characters from current_tag_
-    while (!current_tag_.empty() && std::isspace(current_tag_.back())) {
+    while (!current_tag_.empty() && IsSpace(current_tag_.back())) {
       current_tag_.pop_back();
     }
-    skipping_leading_whitespace = true; // Reset for next tag
-    if (!is_self_closing_tag_)
-      return OnHasLeftTag();
-    else {
+
+    tokenizer_state_ = TokenizerState::kText;
+
+    if (!is_self_closing_tag_) {
+      OnHasLeftTag();
+    } else {
       OnHasLeftTag();
       is_self_closing_tag_ = false;
       is_closing_tag_ = true;
-      return OnHasLeftTag();
+      OnHasLeftTag();
     }
-  }
 
-  if (ch == '"') {
-    if (is_in_attribute_value_) {
-      is_in_attribute_value_ = false;
-    } else {
-      size_t pos = current_tag_.length();
-      while (pos > 0 && isspace(current_tag_[pos - 1])) {
-        pos--;
-      }
-      if (pos > 0 && current_tag_[pos - 1] == '=') {
-        is_in_attribute_value_ = true;
-      }
+    is_plain_text_ =
+        !is_in_code_ && !IsInIgnoredTag() && current_tag_ != kTagLink;
+    return;
+  case kClassDoubleQuote:
+  case kClassSingleQuote: {
+    // A quote after '=' starts a value. Other double quotes are dropped, other
+    // single quotes kept.
+    size_t pos = current_tag_.length();
+    while (pos > 0 && IsSpace(current_tag_[pos - 1])) {
+      pos--;
     }
-    skipping_leading_whitespace = false; // Stop skipping after attribute
-    return true;
-  }
 
-  // Handle whitespace: skip leading whitespace, keep others
-  if (isspace(ch) && skipping_leading_whitespace) {
-    return true; // Ignore leading whitespace
+    if (pos > 0 && current_tag_[pos - 1] == '=') {
+      tokenizer_state_ = ch == '"' ? TokenizerState::kDoubleQuotedValue
+                                   : TokenizerState::kSingleQuotedValue;
+      return;
+    }
+
+    tokenizer_state_ = TokenizerState::kTag;
+    if (ch == '"')
+      return;
+    break;
+  }
+  case kClassSpace:
+  case kClassNewline:
+    // Skip leading whitespace, keep others
+    if (tokenizer_state_ == TokenizerState::kTagStart)
+      return;
+    break;
+  default:
+    break;
   }
 
-  // Once we encounter a non-whitespace character, stop skipping
-  skipping_leading_whitespace = false;
-  current_tag_ += tolower(ch);
-  return false;
+  tokenizer_state_ = TokenizerState::kTag;
+  current_tag_ += ToLower(ch);
 }
 
 bool Converter::OnHasLeftTag() {
@@ -599,23 +1831,31 @@ bool Converter::OnHasLeftTag() {
   // Extract tag name without Split() - just find first space
   size_t space_pos = current_tag_.find(' ');
   if (space_pos != string::npos) {
-    current_tag_ = current_tag_.substr(0, space_pos);
+    current_tag_.resize(space_pos);
   }
-  
+
   if (current_tag_.empty())
     return true;
 
-  auto tag = tags_[current_tag_];
+  if (stats_ && !is_closing_tag_)
+    ++stats_->tags[current_tag_];
+
+  const auto &tags = Tags();
+  auto it = tags.find(current_tag_);
 
-  if (!tag)
+  if (it == tags.end())
     return true;
 
+  const auto &tag = it->second;
+
   if (!is_closing_tag_) {
+    HTML2MD_TRACE_SCOPE(kOpeningTag, it->first.c_str());
     tag->OnHasLeftOpeningTag(this);
   }
   else {
     is_closing_tag_ = false;
 
+    HTML2MD_TRACE_SCOPE(kClosingTag, it->first.c_str());
     tag->OnHasLeftClosingTag(this);
   }
 
@@ -623,7 +1863,14 @@ bool Converter::OnHasLeftTag() {
 }
 
 Converter *Converter::ShortenMarkdown(size_t chars) {
-  md_ = md_.substr(0, md_.length() - chars);
+  // Truncate in place, copying md_ made repeated calls quadratic
+  if (chars <= md_.length())
+    md_.resize(md_.length() - chars);
+  md_low_water_ = std::min(md_low_water_, md_.length());
+  last_text_end_ = std::min(last_text_end_, md_.length());
+
+  if (md_.length() < no_space_end_)
+    no_space_end_ = 0;
 
   if (chars > chars_in_curr_line_)
     chars_in_curr_line_ = 0;
@@ -633,6 +1880,7 @@ Converter *Converter::ShortenMarkdown(size_t chars) {
   return this->UpdatePrevChFromMd();
 }
 
+template <bool kCompressWhitespace>
 bool Converter::ParseCharInTagContent(char ch) {
   if (is_in_code_) {
     md_ += ch;
@@ -643,7 +1891,7 @@ bool Converter::ParseCharInTagContent(char ch) {
     return true;
   }
 
-  if (option.compressWhitespace && !is_in_pre_) {
+  if (kCompressWhitespace && !is_in_pre_) {
     if (ch == '\t')
       ch = ' ';
 
@@ -657,6 +1905,9 @@ bool Converter::ParseCharInTagContent(char ch) {
   if (IsInIgnoredTag() || current_tag_ == kTagLink) {
     prev_ch_in_html_ = ch;
 
+    if (stats_)
+      ++stats_->ignoredBytes;
+
     return true;
   }
 
@@ -680,28 +1931,75 @@ bool Converter::ParseCharInTagContent(char ch) {
   case '\\':
     appendToMd("\\\\");
     break;
+  case '_':
+  case '[':
+  case ']':
+  case '|':
+  case '#':
+  case '-':
+  case '+':
+  case '>': {
+    // Only looked at with escapeMarkdown
+    bool escape = option.escapeMarkdown;
+    if (ch == '|')
+      escape = escape && is_in_table_;
+    else if (ch != '_' && ch != '[' && ch != ']')
+      escape = escape && IsAtLineStart();
+
+    if (escape) {
+      md_ += '\\';
+      ++chars_in_curr_line_;
+    }
+    md_ += ch;
+    ++chars_in_curr_line_;
+    break;
+  }
+  case '&':
+    // A "&gt;" starting here would become a blockquote marker
+    line_start_amp_ = option.escapeMarkdown && IsAtLineStart()
+                          ? md_.length()
+                          : string::npos;
+    md_ += ch;
+    ++chars_in_curr_line_;
+    break;
+  case ';':
+    // "&lt;" and "&gt;" become '<' and '>' when the entities are decoded after
+    // the conversion
+    if (option.escapeMarkdown && !option.keepHtmlEntities &&
+        md_.length() >= 3) {
+      const size_t amp = md_.length() - 3;
+      md_low_water_ = std::min(md_low_water_, amp);
+
+      if (md_.compare(amp, 3, "&lt") == 0 ||
+          (amp == line_start_amp_ && md_.compare(amp, 3, "&gt") == 0)) {
+        md_.insert(amp, 1, '\\');
+        ++chars_in_curr_line_;
+      }
+    }
+    md_ += ch;
+    ++chars_in_curr_line_;
+    break;
   case '.': {
+    // Is the line so far only whitespace followed by digits? Scan backwards,
+    // so the common case (the line doesn't end with a digit) is O(1) and a
+    // run of dots after a long number doesn't rescan the line each time.
     bool is_ordered_list_start = false;
-    if (chars_in_curr_line_ > 0) {
+    if (option.escapeNumberedList && chars_in_curr_line_ > 0) {
       size_t start_idx = md_.length() - chars_in_curr_line_;
-      size_t idx = start_idx;
-      // Skip spaces
-      while (idx < md_.length() && isspace(md_[idx])) {
-        idx++;
-      }
-      // Check digits
-      bool has_digits = false;
-      while (idx < md_.length() && isdigit(md_[idx])) {
-        has_digits = true;
-        idx++;
+      size_t idx = md_.length();
+      md_low_water_ = std::min(
+          md_low_water_, chars_in_curr_line_ <= idx ? start_idx : size_t(0));
+      while (idx > start_idx && IsAsciiDigit(md_[idx - 1])) {
+        idx--;
       }
-      // If we reached the end and had digits, it's a match
-      if (has_digits && idx == md_.length()) {
-        is_ordered_list_start = true;
+      bool has_digits = idx != md_.length();
+      while (has_digits && idx > start_idx && IsSpace(md_[idx - 1])) {
+        idx--;
       }
+      is_ordered_list_start = has_digits && idx == start_idx;
     }
 
-    if (is_ordered_list_start && option.escapeNumberedList) {
+    if (is_ordered_list_start) {
       appendToMd("\\.");
     } else {
       md_ += ch;
@@ -715,23 +2013,27 @@ bool Converter::ParseCharInTagContent(char ch) {
     break;
   }
 
-  if (chars_in_curr_line_ > option.softBreak && !is_in_table_ && !is_in_list_ &&
-      current_tag_ != kTagImg && current_tag_ != kTagAnchor &&
-      option.splitLines) {
-    if (ch == ' ') { // If the next char is - it will become a list
-      md_ += '\n';
-      chars_in_curr_line_ = 0;
-    } else if (chars_in_curr_line_ > option.hardBreak) {
-      ReplacePreviousSpaceInLineByNewline();
-    }
-  }
-
+  last_text_end_ = md_.length();
   return false;
 }
 
+bool Converter::IsAtLineStart() {
+  // Spaces before a block marker don't change its meaning, they are skipped
+  // whether they are text or not
+  size_t i = md_.length();
+  while (i > 0 && md_[i - 1] == ' ')
+    --i;
+
+  while (i > last_text_end_ && md_[i - 1] != '\n')
+    --i;
+
+  md_low_water_ = std::min(md_low_water_, i > 0 ? i - 1 : 0);
+  return i == 0 || md_[i - 1] == '\n';
+}
+
 bool Converter::ReplacePreviousSpaceInLineByNewline() {
   if (current_tag_ == kTagParagraph ||
-      is_in_table_ && (prev_tag_ != kTagCode && prev_tag_ != kTagPre))
+      (is_in_table_ && prev_tag_ != kTagCode && prev_tag_ != kTagPre))
     return false;
 
   auto offset = md_.length() - 1;
@@ -739,20 +2041,30 @@ bool Converter::ReplacePreviousSpaceInLineByNewline() {
   if (md_.length() == 0)
     return true;
 
+  // Stop where the previous unsuccessful search started, otherwise a long
+  // line without spaces is searched again for every char added to it
   do {
-    if (md_[offset] == '\n')
+    if (md_[offset] == '\n') {
+      md_low_water_ = std::min(md_low_water_, offset);
+      no_space_end_ = md_.length();
       return false;
+    }
 
     if (md_[offset] == ' ') {
+      md_low_water_ = std::min(md_low_water_, offset);
       md_[offset] = '\n';
       chars_in_curr_line_ = md_.length() - offset;
 
       return true;
     }
 
+    if (offset == 0)
+      break;
     --offset;
-  } while (offset > 0);
+  } while (offset > 0 && offset >= no_space_end_);
 
+  md_low_water_ = std::min(md_low_water_, offset);
+  no_space_end_ = md_.length();
   return false;
 }
 
@@ -760,20 +2072,20 @@ void Converter::TagAnchor::OnHasLeftOpeningTag(Converter *c) {
   if (c->prev_tag_ == kTagImg)
     c->appendToMd('\n');
 
-  current_title_ = c->ExtractAttributeFromTagLeftOf(kAttributeTitle);
+  c->current_title_ = c->ExtractAttributeFromTagLeftOf(kAttributeTitle);
 
   c->appendToMd('[');
-  current_href_ = c->ExtractAttributeFromTagLeftOf(kAttributeHref);
+  c->current_href_ = c->ExtractAttributeFromTagLeftOf(kAttributeHref);
 }
 
 void Converter::TagAnchor::OnHasLeftClosingTag(Converter *c) {
   if (!c->shortIfPrevCh('[')) {
-    c->appendToMd("](")->appendToMd(current_href_);
+    c->appendToMd("](")->appendToMd(c->current_href_);
 
     // If title is set append it
-    if (!current_title_.empty()) {
-      c->appendToMd(" \"")->appendToMd(current_title_)->appendToMd('"');
-      current_title_.clear();
+    if (!c->current_title_.empty()) {
+      c->appendToMd(" \"")->appendToMd(c->current_title_)->appendToMd('"');
+      c->current_title_.clear();
     }
 
     c->appendToMd(')');
@@ -1091,6 +2403,7 @@ void Converter::TagSeperator::OnHasLeftClosingTag(Converter *c) {}
 
 void Converter::TagTable::OnHasLeftOpeningTag(Converter *c) {
   c->is_in_table_ = true;
+  ++c->index_table;
   c->appendToMd('\n');
   c->table_start = c->md_.length(); // Set start AFTER the newline
 }
@@ -1099,13 +2412,29 @@ void Converter::TagTable::OnHasLeftClosingTag(Converter *c) {
   c->is_in_table_ = false;
   c->appendToMd('\n');
 
-  if (!c->option.formatTable)
+  // A stray "</table>" would format everything since the last table
+  if (c->index_table == 0)
+    return;
+  --c->index_table;
+
+  // Mis-nested tags, e.g. "<blockquote><table></blockquote>", can remove
+  // Markdown before the table started
+  if (!c->option.formatTable || c->table_start > c->md_.size())
     return;
 
-  string table = c->md_.substr(c->table_start);
-  table = formatMarkdownTable(table);
+  ScopedTimer timer(c->stats_ ? &c->stats_->tableNs : nullptr);
+  HTML2MD_TRACE_SCOPE(kTable, "");
+
+  // Format straight from md_, the table is copied only once to put the
+  // formatted one in its place
+  string table;
+  formatMarkdownTable(c->md_.data() + c->table_start,
+                      c->md_.size() - c->table_start, &table);
   c->ShortenMarkdown(c->md_.size() - c->table_start);
   c->appendToMd(table);
+
+  if (c->stats_)
+    ++c->stats_->tablesFormatted;
 }
 
 void Converter::TagTableRow::OnHasLeftOpeningTag(Converter *c) {
@@ -1131,6 +2460,9 @@ void Converter::TagTableRow::OnHasLeftClosingTag(Converter *c) {
 
 
 void Converter::TagTableHeader::OnHasLeftOpeningTag(Converter *c) {
+  if (c->stats_)
+    ++c->stats_->tableCells;
+
   auto align = c->ExtractAttributeFromTagLeftOf(kAttrinuteAlign);
 
   string line = "| ";
@@ -1156,6 +2488,9 @@ void Converter::TagTableHeader::OnHasLeftClosingTag(Converter *c) {
 
 
 void Converter::TagTableData::OnHasLeftOpeningTag(Converter *c) {
+  if (c->stats_)
+    ++c->stats_->tableCells;
+
   c->appendToMd("| ");
 }
 
@@ -1185,6 +2520,9 @@ void Converter::reset() {
   prev_ch_in_md_ = 0;
   prev_prev_ch_in_md_ = 0;
   index_ch_in_html_ = 0;
+  tokenizer_state_ = TokenizerState::kText;
+  is_plain_text_ = !is_in_code_ && !IsInIgnoredTag() && current_tag_ != kTagLink;
+  no_space_end_ = 0;
 }
 
 bool Converter::IsInIgnoredTag() const {
@@ -0,0 +1,255 @@
+// Copyright (c) Tim Gromeyer
+// Licensed under the MIT License - https://opensource.org/licenses/MIT
+
+#include "html2md_c.h"
+#include "html2md.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <new>
+#include <string>
+
+using std::string;
+
+struct html2md_engine {
+  html2md::Options options;
+  bool collect_stats = false;
+
+  // Conversion fed by html2md_feed(), nullptr if none is running
+  std::unique_ptr<html2md::Converter> stream;
+  size_t fed_bytes = 0;
+
+  // Result of the last conversion
+  string md;
+  html2md::ConversionStats stats;
+
+  string error;
+};
+
+namespace {
+// Sizes of the first version of the structs, which callers' structs have at
+// least. A field added later may only be touched if struct_size covers it.
+constexpr size_t kOptionsSize =
+    offsetof(html2md_options, collect_stats) + sizeof(int);
+constexpr size_t kStatsSize =
+    offsetof(html2md_stats, total_ns) + sizeof(uint64_t);
+
+html2md::Options ToOptions(const html2md_options &o) {
+  html2md::Options options;
+  options.splitLines = o.split_lines != 0;
+  options.softBreak = o.soft_break;
+  options.hardBreak = o.hard_break;
+  options.unorderedList = o.unordered_list;
+  options.orderedList = o.ordered_list;
+  options.includeTitle = o.include_title != 0;
+  options.formatTable = o.format_table != 0;
+  options.forceLeftTrim = o.force_left_trim != 0;
+  options.compressWhitespace = o.compress_whitespace != 0;
+  options.escapeNumberedList = o.escape_numbered_list != 0;
+  options.escapeMarkdown = o.escape_markdown != 0;
+  options.keepHtmlEntities = o.keep_html_entities != 0;
+  options.threads = o.threads;
+  return options;
+}
+
+void SetError(html2md_engine *engine, const char *message) noexcept {
+  try {
+    engine->error = message;
+  } catch (...) {
+    engine->error.clear();
+  }
+}
+
+// Run task, turning the exceptions it throws into a status
+template <typename Task>
+html2md_status Guard(html2md_engine *engine, Task task) noexcept {
+  try {
+    engine->error.clear();
+    return task();
+  } catch (const std::bad_alloc &) {
+    SetError(engine, "out of memory");
+    return HTML2MD_OUT_OF_MEMORY;
+  } catch (const std::exception &e) {
+    SetError(engine, e.what());
+    return HTML2MD_ERROR;
+  } catch (...) {
+    SetError(engine, "unknown error");
+    return HTML2MD_ERROR;
+  }
+}
+
+// Copy the Markdown of engine to out if it fits
+html2md_status CopyOut(const html2md_engine *engine, char *out, size_t cap,
+                       size_t *needed) {
+  const string &md = engine->md;
+
+  if (needed != nullptr)
+    *needed = md.size();
+
+  if (cap < md.size())
+    return HTML2MD_BUFFER_TOO_SMALL;
+
+  if (!md.empty())
+    memcpy(out, md.data(), md.size());
+  if (cap > md.size())
+    out[md.size()] = '\0';
+
+  return HTML2MD_OK;
+}
+} // namespace
+
+html2md_status html2md_options_init(html2md_options *options) {
+  if (options == nullptr || options->struct_size < kOptionsSize)
+    return HTML2MD_INVALID_ARGUMENT;
+
+  const html2md::Options defaults;
+  const size_t struct_size = options->struct_size;
+  memset(options, 0, std::min(struct_size, sizeof(*options)));
+  options->struct_size = struct_size;
+  options->split_lines = defaults.splitLines;
+  options->soft_break = defaults.softBreak;
+  options->hard_break = defaults.hardBreak;
+  options->unordered_list = defaults.unorderedList;
+  options->ordered_list = defaults.orderedList;
+  options->include_title = defaults.includeTitle;
+  options->format_table = defaults.formatTable;
+  options->force_left_trim = defaults.forceLeftTrim;
+  options->compress_whitespace = defaults.compressWhitespace;
+  options->escape_numbered_list = defaults.escapeNumberedList;
+  options->escape_markdown = defaults.escapeMarkdown;
+  options->keep_html_entities = defaults.keepHtmlEntities;
+  options->threads = defaults.threads;
+  options->collect_stats = 0;
+  return HTML2MD_OK;
+}
+
+html2md_engine *html2md_engine_new(const html2md_options *options) {
+  if (options != nullptr && options->struct_size < kOptionsSize)
+    return nullptr;
+
+  auto *engine = new (std::nothrow) html2md_engine;
+  if (engine == nullptr || options == nullptr)
+    return engine;
+
+  engine->options = ToOptions(*options);
+  engine->collect_stats = options->collect_stats != 0;
+  return engine;
+}
+
+void html2md_engine_free(html2md_engine *engine) { delete engine; }
+
+html2md_status html2md_convert(html2md_engine *engine, const char *html,
+                               size_t size, char *out, size_t cap,
+                               size_t *needed) {
+  // A conversion started with html2md_feed() must be finished first
+  if (engine == nullptr || (html == nullptr && size != 0) ||
+      (out == nullptr && cap != 0) || engine->stream)
+    return HTML2MD_INVALID_ARGUMENT;
+
+  return Guard(engine, [&]() -> html2md_status {
+    engine->stats = html2md::ConversionStats();
+
+    if (engine->collect_stats || engine->options.threads != 1) {
+      // The statistics and the parallel conversion need all of the HTML in
+      // the Converter
+      html2md::Converter converter(string(html, size), &engine->options);
+      engine->md = converter.convert(engine->collect_stats ? &engine->stats
+                                                           : nullptr);
+    } else {
+      // Fed as one chunk, the HTML is read in place
+      html2md::Converter converter(string(), &engine->options);
+      converter.feed(html, size);
+      engine->md = converter.finish();
+    }
+
+    engine->stats.inputBytes = size;
+    engine->stats.outputBytes = engine->md.size();
+    return CopyOut(engine, out, cap, needed);
+  });
+}
+
+html2md_status html2md_feed(html2md_engine *engine, const char *chunk,
+                            size_t size) {
+  if (engine == nullptr || (chunk == nullptr && size != 0))
+    return HTML2MD_INVALID_ARGUMENT;
+
+  return Guard(engine, [&]() -> html2md_status {
+    if (!engine->stream) {
+      engine->stream.reset(new html2md::Converter(string(), &engine->options));
+      engine->fed_bytes = 0;
+    }
+
+    engine->stream->feed(chunk, size);
+    engine->fed_bytes += size;
+    return HTML2MD_OK;
+  });
+}
+
+html2md_status html2md_finish(html2md_engine *engine, char *out, size_t cap,
+                              size_t *needed) {
+  if (engine == nullptr || (out == nullptr && cap != 0))
+    return HTML2MD_INVALID_ARGUMENT;
+
+  return Guard(engine, [&]() -> html2md_status {
+    if (!engine->stream)
+      return HTML2MD_INVALID_ARGUMENT;
+
+    std::unique_ptr<html2md::Converter> converter = std::move(engine->stream);
+    engine->md = converter->finish();
+
+    engine->stats = html2md::ConversionStats();
+    engine->stats.inputBytes = engine->fed_bytes;
+    engine->stats.outputBytes = engine->md.size();
+    return CopyOut(engine, out, cap, needed);
+  });
+}
+
+html2md_status html2md_output(const html2md_engine *engine, const char **data,
+                              size_t *size) {
+  if (engine == nullptr || data == nullptr)
+    return HTML2MD_INVALID_ARGUMENT;
+
+  *data = engine->md.c_str();
+  if (size != nullptr)
+    *size = engine->md.size();
+
+  return HTML2MD_OK;
+}
+
+html2md_status html2md_engine_stats(const html2md_engine *engine,
+                                    html2md_stats *stats) {
+  if (engine == nullptr || stats == nullptr || stats->struct_size < kStatsSize)
+    return HTML2MD_INVALID_ARGUMENT;
+
+  const html2md::ConversionStats &s = engine->stats;
+
+  const size_t struct_size = stats->struct_size;
+  memset(stats, 0, std::min(struct_size, sizeof(*stats)));
+  stats->struct_size = struct_size;
+  stats->input_bytes = s.inputBytes;
+  stats->output_bytes = s.outputBytes;
+  stats->estimated_output_bytes = s.estimatedOutputBytes;
+  for (const auto &tag : s.tags)
+    stats->tags += tag.second;
+  stats->ignored_bytes = s.ignoredBytes;
+  stats->entities_decoded = s.entitiesDecoded;
+  stats->tables_formatted = s.tablesFormatted;
+  stats->table_cells = s.tableCells;
+  stats->reallocations = s.reallocations;
+  stats->tokenize_ns = s.tokenizeNs;
+  stats->tidy_ns = s.tidyNs;
+  stats->entities_ns = s.entitiesNs;
+  stats->replace_ns = s.replaceNs;
+  stats->table_ns = s.tableNs;
+  stats->wrap_ns = s.wrapNs;
+  stats->total_ns = s.totalNs;
+
+  return HTML2MD_OK;
+}
+
+const char *html2md_engine_error(const html2md_engine *engine) {
+  return engine != nullptr ? engine->error.c_str() : "";
+}
@@ -0,0 +1,103 @@
+// Copyright (c) Tim Gromeyer
+// Licensed under the MIT License - https://opensource.org/licenses/MIT
+
+#ifndef HTML2MD_INTERNAL_H
+#define HTML2MD_INTERNAL_H
+
+// Stages of the conversion that don't depend on the state of the Converter.
+// They are not part of the API and not installed; they are declared here so
+// tests/microbench.cpp can measure them in isolation.
+
+#include <cstddef>
+#include <exception>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace html2md {
+namespace detail {
+
+// Replace all occurrences of needle, returns the amount replaced
+size_t ReplaceAll(std::string *haystack, const std::string &needle,
+                  const std::string &replacement);
+
+// 1. trim all lines, except within code blocks
+// 2. reduce consecutive newlines to maximum 3
+void TidyAllLines(std::string *str, bool forceLeftTrim);
+
+// TidyAllLines() on the lines in [data, data + len), which end with a newline,
+// in place. in_code_block is whether the lines start inside a code block.
+// Returns the new length.
+size_t TidyLines(char *data, size_t len, bool forceLeftTrim, bool in_code_block);
+
+// Whether the lines in [data, data + len) open or close a code block an odd
+// amount of times, as seen by TidyLines()
+bool TogglesCodeBlock(const char *data, size_t len);
+
+// Offsets at which md can be cut into parts of at least min_part bytes (about
+// `parts` of them) that are cleaned up independently: every part after the
+// first starts a line beginning with an ASCII letter or digit. Such a line is
+// never blank and no fence, and none of the clean up steps match across its
+// start, so only the code block state has to be passed from part to part.
+// Starts with 0 and ends with md.size().
+std::vector<size_t> CleanUpCuts(const std::string &md, size_t parts,
+                                size_t min_part);
+
+// Replace the HTML entities in md by their symbols, returns the amount replaced
+size_t DecodeEntities(
+    std::string *md,
+    const std::unordered_map<std::string, std::string> &conversions);
+
+// Final search-and-replace clean up of the Markdown
+void ReplaceLeftovers(std::string *md);
+
+// Break lines wider than soft_break columns at the next space, or at the
+// previous one once they get wider than hard_break. Code, tables, headings,
+// links and code spans are never broken; continuation lines keep the
+// blockquote markers and list indentation. Returns whether md ends within a
+// code fence.
+bool WrapLines(std::string *md, size_t soft_break, size_t hard_break);
+
+// Value of attribute attr in the tag [tag, tag + tag_len), or an empty string
+std::string ExtractAttribute(const char *tag, size_t tag_len,
+                             const std::string &attr);
+
+// Calls task(0) to task(count - 1), each on its own thread except task(0),
+// which runs on the calling thread. Where no thread can be started (e.g.
+// WebAssembly without pthreads, or out of memory) the task runs on the
+// calling thread instead, so all started threads are always joined. The
+// first exception thrown by a task is rethrown once all are done.
+template <typename Task> void RunConcurrently(size_t count, const Task &task) {
+  std::vector<std::exception_ptr> errors(count);
+  auto run = [&](size_t i) {
+    try {
+      task(i);
+    } catch (...) {
+      errors[i] = std::current_exception();
+    }
+  };
+
+  std::vector<std::thread> threads;
+  threads.reserve(count);
+  for (size_t i = 1; i < count; ++i) {
+    try {
+      threads.emplace_back(run, i);
+    } catch (...) {
+      run(i);
+    }
+  }
+
+  run(0);
+  for (auto &thread : threads)
+    thread.join();
+
+  for (auto &error : errors)
+    if (error)
+      std::rethrow_exception(error);
+}
+
+} // namespace detail
+} // namespace html2md
+
+#endif // HTML2MD_INTERNAL_H
@@ -3,104 +3,135 @@
 
 #include "table.h"
 
-#include <iomanip>
-#include <iostream>
-#include <sstream>
+#include <algorithm>
+#include <cstring>
 #include <vector>
 
 using std::string;
 using std::vector;
 
+namespace {
 const size_t MIN_LINE_LENGTH = 3; // Minimum length of line
 
-void removeLeadingTrailingSpaces(string &str) {
-  size_t firstNonSpace = str.find_first_not_of(' ');
-  if (firstNonSpace == string::npos) {
-    str.clear(); // Entire string is spaces
+// A cell of the table without the spaces around it, as offsets into the
+// unformatted table
+struct Cell {
+  size_t begin;
+  size_t size;
+};
+
+// Append the cell of the delimiter row below the header cell `cell`, keeping
+// the colons that align the column
+void appendHeaderLine(const char *cell, size_t size, size_t length,
+                      string *out) {
+  if (size == 0 || length < MIN_LINE_LENGTH)
     return;
-  }
-
-  size_t lastNonSpace = str.find_last_not_of(' ');
-  str = str.substr(firstNonSpace, lastNonSpace - firstNonSpace + 1);
-}
 
-string enlargeTableHeaderLine(const string &str, size_t length) {
-  if (str.empty() || length < MIN_LINE_LENGTH)
-    return "";
+  const bool left = cell[0] == ':';
+  const bool right = cell[size - 1] == ':' && (size > 1 || !left);
 
-  size_t first = str.find_first_of(':');
-  size_t last = str.find_last_of(':');
+  const size_t start = out->size();
+  out->append(length, '-');
 
-  if (first == 0 && first == last)
-    last = string::npos;
-
-  string line = string(length, '-');
+  if (left)
+    (*out)[start] = ':';
+  if (right)
+    (*out)[start + length - 1] = ':';
+}
+} // namespace
+
+void formatMarkdownTable(const char *table, size_t size, string *out) {
+  vector<Cell> cells;
+  vector<size_t> rowEnds; // Index into cells after the last cell of each row
+
+  // Parse the input table into cells, skipping empty ones and empty rows
+  for (size_t lineStart = 0; lineStart < size;) {
+    auto *newline = static_cast<const char *>(
+        memchr(table + lineStart, '\n', size - lineStart));
+    const size_t lineEnd = newline ? newline - table : size;
+    const size_t rowStart = cells.size();
+
+    // Split at every '|' that isn't escaped as "\|"
+    size_t cellStart = lineStart;
+    for (size_t i = lineStart; i <= lineEnd; ++i) {
+      if (i + 1 < lineEnd && table[i] == '\\') {
+        ++i;
+        continue;
+      }
 
-  if (first == 0)
-    line[0] = ':';
-  if (last == str.length() - 1)
-    line[length - 1] = ':';
+      if (i < lineEnd && table[i] != '|')
+        continue;
 
-  return line;
-}
+      size_t begin = cellStart;
+      size_t end = i;
+      while (begin < end && table[begin] == ' ')
+        ++begin;
+      while (end > begin && table[end - 1] == ' ')
+        --end;
 
-string formatMarkdownTable(const string &inputTable) {
-  std::istringstream iss(inputTable);
-  string line;
-  vector<vector<string>> tableData;
-
-  // Parse the input table into a 2D vector
-  while (std::getline(iss, line)) {
-    std::istringstream lineStream(line);
-    string cell;
-    vector<string> rowData;
-
-    while (std::getline(lineStream, cell, '|')) {
-      removeLeadingTrailingSpaces(cell); // Trim first
-      if (!cell.empty()) { // Then check if empty
-        rowData.push_back(cell);
-      }
+      if (begin != end)
+        cells.push_back({begin, end - begin});
+      cellStart = i + 1;
     }
 
-    if (!rowData.empty()) {
-      tableData.push_back(std::move(rowData)); // Move rowData to avoid copying
-    }
-  }
+    if (cells.size() != rowStart)
+      rowEnds.push_back(cells.size());
 
-  if (tableData.empty()) { 
-    return ""; 
+    lineStart = lineEnd + 1;
   }
 
+  if (rowEnds.empty())
+    return;
+
   // Determine maximum width of each column
-  vector<size_t> columnWidths(tableData[0].size(), 0);
-  for (const auto &row : tableData) {
-    if (columnWidths.size() < row.size()) {
-      columnWidths.resize(row.size(), 0);
-    }
+  vector<size_t> columnWidths;
+  size_t rowStart = 0;
+  for (size_t rowEnd : rowEnds) {
+    if (columnWidths.size() < rowEnd - rowStart)
+      columnWidths.resize(rowEnd - rowStart, 0);
 
-    for (size_t i = 0; i < row.size(); ++i) {
-      columnWidths[i] = std::max(columnWidths[i], row[i].size());
-    }
+    for (size_t i = rowStart; i < rowEnd; ++i)
+      columnWidths[i - rowStart] =
+          std::max(columnWidths[i - rowStart], cells[i].size);
+
+    rowStart = rowEnd;
   }
 
+  size_t rowWidth = 2;
+  for (size_t width : columnWidths)
+    rowWidth += width + 3;
+  out->reserve(out->size() + rowWidth * rowEnds.size());
+
   // Build the formatted table
-  std::ostringstream formattedTable;
-  for (size_t rowNumber = 0; rowNumber < tableData.size(); ++rowNumber) {
-    const auto &row = tableData[rowNumber];
+  rowStart = 0;
+  for (size_t rowNumber = 0; rowNumber < rowEnds.size(); ++rowNumber) {
+    const size_t rowEnd = rowEnds[rowNumber];
+
+    *out += '|';
 
-    formattedTable << "|";
+    for (size_t i = rowStart; i < rowEnd; ++i) {
+      const Cell &cell = cells[i];
+      const size_t width = columnWidths[i - rowStart];
 
-    for (size_t i = 0; i < row.size(); ++i) {
       if (rowNumber == 1) {
-        formattedTable << enlargeTableHeaderLine(row[i], columnWidths[i] + 2)
-                       << "|";
+        appendHeaderLine(table + cell.begin, cell.size, width + 2, out);
+        *out += '|';
         continue;
       }
-      formattedTable << " " << std::setw(columnWidths[i]) << std::left << row[i]
-                     << " |";
+
+      *out += ' ';
+      out->append(table + cell.begin, cell.size);
+      out->append(width - cell.size, ' ');
+      out->append(" |");
     }
-    formattedTable << "\n";
+    *out += '\n';
+
+    rowStart = rowEnd;
   }
+}
 
-  return formattedTable.str();
+string formatMarkdownTable(const string &inputTable) {
+  string formattedTable;
+  formatMarkdownTable(inputTable.data(), inputTable.size(), &formattedTable);
+  return formattedTable;
 }
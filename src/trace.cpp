@@ -0,0 +1,56 @@
+// Copyright (c) Tim Gromeyer
+// Licensed under the MIT License - https://opensource.org/licenses/MIT
+
+#include "trace.h"
+
+#ifdef HTML2MD_TRACING
+
+#include <atomic>
+
+#ifdef HTML2MD_HAVE_SDT
+#include <sys/sdt.h>
+#endif
+
+namespace {
+struct Listener {
+  html2md::trace::Callback callback;
+  void *userData;
+};
+
+std::atomic<const Listener *> listener{nullptr};
+
+void Emit(html2md::trace::Phase phase, const char *name, bool begin) {
+#ifdef HTML2MD_HAVE_SDT
+  if (begin)
+    DTRACE_PROBE2(html2md, begin, static_cast<int>(phase), name);
+  else
+    DTRACE_PROBE2(html2md, end, static_cast<int>(phase), name);
+#endif
+
+  const Listener *l = listener.load(std::memory_order_acquire);
+  if (l != nullptr)
+    l->callback(phase, name, begin, l->userData);
+}
+} // namespace
+
+namespace html2md {
+namespace trace {
+
+void setCallback(Callback callback, void *userData) {
+  // Listeners are never freed: a conversion on another thread may still be
+  // using the previous one. Setting the callback is rare, so this is cheap.
+  const Listener *l =
+      callback ? new Listener{callback, userData} : nullptr;
+  listener.store(l, std::memory_order_release);
+}
+
+Scope::Scope(Phase phase, const char *name) : phase_(phase), name_(name) {
+  Emit(phase_, name_, true);
+}
+
+Scope::~Scope() { Emit(phase_, name_, false); }
+
+} // namespace trace
+} // namespace html2md
+
+#endif // HTML2MD_TRACING
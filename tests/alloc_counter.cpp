@@ -0,0 +1,100 @@
+// Copyright (c) Tim Gromeyer
+// Licensed under the MIT License - https://opensource.org/licenses/MIT
+
+#include "alloc_counter.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+namespace {
+// Counted per thread, so concurrent conversions don't disturb each other.
+// Memory freed by another thread than the one that allocated it makes `used`
+// of the freeing thread go down, hence signed.
+thread_local int64_t used = 0;
+thread_local int64_t baseline = 0;
+thread_local int64_t peak = 0;
+thread_local size_t allocations = 0;
+thread_local size_t bytes = 0;
+
+// The size of every block is stored in front of it, so delete knows how much
+// is freed without relying on sized deallocation
+constexpr size_t kHeader = alignof(std::max_align_t);
+
+void *allocate(size_t size) {
+  auto *block = static_cast<char *>(malloc(size + kHeader));
+  if (block == nullptr)
+    return nullptr;
+
+  *reinterpret_cast<size_t *>(block) = size;
+
+  used += static_cast<int64_t>(size);
+  if (used > peak)
+    peak = used;
+  ++allocations;
+  bytes += size;
+
+  return block + kHeader;
+}
+
+void deallocate(void *ptr) {
+  if (ptr == nullptr)
+    return;
+
+  char *block = static_cast<char *>(ptr) - kHeader;
+  used -= static_cast<int64_t>(*reinterpret_cast<size_t *>(block));
+  free(block);
+}
+} // namespace
+
+void *operator new(size_t size) {
+  void *ptr = allocate(size);
+  if (ptr == nullptr)
+    throw std::bad_alloc();
+  return ptr;
+}
+
+void *operator new[](size_t size) { return operator new(size); }
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept {
+  return allocate(size);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &) noexcept {
+  return allocate(size);
+}
+
+void operator delete(void *ptr) noexcept { deallocate(ptr); }
+
+void operator delete[](void *ptr) noexcept { deallocate(ptr); }
+
+void operator delete(void *ptr, size_t) noexcept { deallocate(ptr); }
+
+void operator delete[](void *ptr, size_t) noexcept { deallocate(ptr); }
+
+void operator delete(void *ptr, const std::nothrow_t &) noexcept {
+  deallocate(ptr);
+}
+
+void operator delete[](void *ptr, const std::nothrow_t &) noexcept {
+  deallocate(ptr);
+}
+
+namespace alloc {
+
+void reset() {
+  baseline = used;
+  peak = used;
+  allocations = 0;
+  bytes = 0;
+}
+
+Stats get() {
+  Stats stats;
+  stats.allocations = allocations;
+  stats.bytes = bytes;
+  stats.peak = peak > baseline ? static_cast<size_t>(peak - baseline) : 0;
+  return stats;
+}
+
+} // namespace alloc
@@ -0,0 +1,27 @@
+// Copyright (c) Tim Gromeyer
+// Licensed under the MIT License - https://opensource.org/licenses/MIT
+
+#ifndef ALLOC_COUNTER_H
+#define ALLOC_COUNTER_H
+
+#include <cstddef>
+
+// Counts the heap allocations of the calling thread. Linking alloc_counter.cpp
+// replaces the global operator new and delete.
+namespace alloc {
+
+struct Stats {
+  size_t allocations = 0; // Calls to operator new
+  size_t bytes = 0;       // Bytes requested from operator new
+  size_t peak = 0;        // Most bytes in use at the same time
+};
+
+// Start counting from zero, the memory in use now does not count to the peak
+void reset();
+
+// The counts of the calling thread since reset()
+Stats get();
+
+} // namespace alloc
+
+#endif // ALLOC_COUNTER_H
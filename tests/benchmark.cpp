@@ -1,16 +1,25 @@
 #include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <cmath>
+#include <cstdlib>
+#include <cstring>
 #include <filesystem>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <map>
+#include <memory>
 #include <sstream>
 #include <string>
+#include <thread>
 #include <vector>
 
+#include "alloc_counter.h"
+#include "corpus.h"
 #include "html2md.h"
 #include "md4c-html.h"
+#include "perf_counters.h"
 #include "table.h"
 
 using std::cerr;
@@ -21,7 +30,6 @@ using std::stringstream;
 using std::vector;
 using std::chrono::duration;
 using std::chrono::high_resolution_clock;
-using std::chrono::microseconds;
 namespace fs = std::filesystem;
 
 // Markdown and HTML utility functions
@@ -40,34 +48,85 @@ string toHTML(const string &md) {
   return html.str();
 }
 
-string fromHTML(string &html) {
-  static html2md::Options options;
+// Set by main() before any conversion, then only read (also by several
+// threads)
+html2md::Options options = [] {
+  html2md::Options options;
   options.splitLines = false;
-  html2md::Converter c(html, &options);
+  return options;
+}();
+
+string fromHTML(const string &html, html2md::Options *with = &options) {
+  html2md::Converter c(html, with);
   return c.convert();
 }
 } // namespace markdown
 
+// Command line options
+struct Settings {
+  vector<size_t> sizes = {1024, 64 * 1024, 1024 * 1024};
+  // Also measured for fragments unless --sizes is given, for the latency of
+  // small documents
+  vector<size_t> fragment_sizes = {100, 4 * 1024};
+  vector<corpus::Shape> shapes = corpus::shapes();
+  double min_time_s = -1.0;  // Measure each test for at least this long
+  int min_iterations = 5;    // ... and at least this often
+  bool files = true;         // Also run the tests/*.md files
+  bool perf = false;         // Read hardware performance counters
+  bool kernels = false;      // Run every test with each tokenizer kernel
+  unsigned threads = 0;      // Measure scaling up to this many threads
+  vector<string> documents;  // HTML files to convert instead of the corpus
+  size_t top = 10;           // Number of slowest documents to show
+  string json;               // Write results to this file
+  string compare;            // Compare against this baseline
+  double threshold = 10.0;   // Regression threshold in percent
+};
+
 // Benchmark result structure
 struct BenchmarkResult {
   string test_name;
-  double avg_time_us;     // Average time in microseconds
-  double std_dev_us;      // Standard deviation in microseconds
   size_t input_size;      // Input size in bytes
+  size_t iterations;      // Number of measured iterations
+  double mean_ns;         // Average time in nanoseconds
+  double std_dev_ns;      // Standard deviation in nanoseconds
+  double p50_ns;          // Median
+  double p90_ns;
+  double p99_ns;
   double throughput_mbps; // Throughput in megabytes per second
+  double docs_per_s;      // Documents per second
+
+  // Hardware counters per input byte, if --perf was given and available
+  perf::Counters counters{};
+  size_t counted_bytes = 0; // Bytes converted while counting
+
+  alloc::Stats memory{}; // Heap usage of converting the document once
+
+  // Scaling runs only: throughput / (threads * single thread throughput)
+  double efficiency = 0.0;
 };
 
 // Benchmark runner class
 class BenchmarkRunner {
 public:
-  void addTest(const string &name, const string &input, bool is_markdown) {
-    tests_.push_back({name, input, is_markdown});
+  explicit BenchmarkRunner(const Settings &settings) : settings_(settings) {
+    if (settings_.perf) {
+      counters_.reset(new perf::CounterSet);
+      if (!counters_->available()) {
+        cerr << "Hardware counters disabled: " << counters_->error() << "\n";
+        counters_.reset();
+      }
+    }
   }
 
-  void run(int iterations) {
+  void addTest(const string &name, string input,
+               const html2md::Options &options = markdown::options) {
+    tests_.push_back({name, std::move(input), options});
+  }
+
+  void run() {
     auto start_total = high_resolution_clock::now(); // Start total timer
     for (const auto &test : tests_) {
-      runTest(test, iterations);
+      runTest(test);
     }
     auto end_total = high_resolution_clock::now(); // End total timer
     total_duration_ms_ =
@@ -75,73 +134,505 @@ public:
     printSummary();
   }
 
+  // Convert all tests on 1, 2, 4, ... max_threads threads at the same time,
+  // each thread with its own Converter, for min_time_s per thread count
+  void runScaling(unsigned max_threads) {
+    vector<unsigned> thread_counts;
+    for (unsigned threads = 1; threads < max_threads; threads *= 2)
+      thread_counts.push_back(threads);
+    thread_counts.push_back(max_threads);
+
+    // Warm up
+    for (const auto &test : tests_)
+      timeOnce(test);
+
+    auto start_total = high_resolution_clock::now();
+    double single_thread_mbps = 0.0;
+
+    for (unsigned threads : thread_counts) {
+      vector<vector<double>> times_ns(threads);
+      vector<size_t> bytes(threads, 0);
+      std::atomic<bool> go(false), stop(false);
+
+      auto worker = [&](unsigned id) {
+        times_ns[id].reserve(1 << 16);
+        while (!go.load(std::memory_order_acquire))
+          std::this_thread::yield();
+
+        // Start at different tests, so the threads don't convert the same
+        // document at the same time
+        for (size_t i = id; !stop.load(std::memory_order_relaxed); ++i) {
+          const auto &test = tests_[i % tests_.size()];
+          times_ns[id].push_back(timeOnce(test));
+          bytes[id] += test.input.size();
+        }
+      };
+
+      vector<std::thread> pool;
+      for (unsigned id = 0; id < threads; ++id)
+        pool.emplace_back(worker, id);
+
+      auto start = high_resolution_clock::now();
+      go.store(true, std::memory_order_release);
+      std::this_thread::sleep_for(duration<double>(settings_.min_time_s));
+      stop.store(true, std::memory_order_relaxed);
+      for (auto &thread : pool)
+        thread.join();
+      auto end = high_resolution_clock::now();
+
+      vector<double> all_ns;
+      size_t total_bytes = 0;
+      for (unsigned id = 0; id < threads; ++id) {
+        all_ns.insert(all_ns.end(), times_ns[id].begin(), times_ns[id].end());
+        total_bytes += bytes[id];
+      }
+
+      double sum = 0.0;
+      for (double t : all_ns)
+        sum += t;
+      double mean_ns = sum / all_ns.size();
+
+      double variance_sum = 0.0;
+      for (double t : all_ns)
+        variance_sum += (t - mean_ns) * (t - mean_ns);
+
+      std::sort(all_ns.begin(), all_ns.end());
+
+      double wall_s = duration<double>(end - start).count();
+      double mbps = total_bytes / (1024.0 * 1024.0) / wall_s;
+      if (threads == 1)
+        single_thread_mbps = mbps;
+
+      BenchmarkResult result{"threads/" + std::to_string(threads),
+                             total_bytes / all_ns.size(),
+                             all_ns.size(),
+                             mean_ns,
+                             std::sqrt(variance_sum / all_ns.size()),
+                             percentile(all_ns, 0.5),
+                             percentile(all_ns, 0.9),
+                             percentile(all_ns, 0.99),
+                             mbps,
+                             all_ns.size() / wall_s};
+      result.efficiency = mbps / (threads * single_thread_mbps);
+      results_.push_back(result);
+    }
+
+    auto end_total = high_resolution_clock::now();
+    total_duration_ms_ =
+        duration<double, std::milli>(end_total - start_total).count();
+    printScaling();
+  }
+
+  // Convert the tests, which are real documents, and show the aggregate
+  // throughput and the `top` slowest documents by ns/byte
+  void runDocuments(size_t top) {
+    auto start_total = high_resolution_clock::now();
+    for (const auto &test : tests_)
+      runTest(test);
+    auto end_total = high_resolution_clock::now();
+    total_duration_ms_ =
+        duration<double, std::milli>(end_total - start_total).count();
+    printDocuments(top);
+  }
+
+  const vector<BenchmarkResult> &results() const { return results_; }
+
 private:
   struct Test {
     string name;
     string input;
-    bool is_markdown; // false for HTML-to-Markdown
+    html2md::Options options;
   };
 
+  const Settings &settings_;
+  std::unique_ptr<perf::CounterSet> counters_;
   vector<Test> tests_;
   vector<BenchmarkResult> results_;
   double total_duration_ms_ = 0.0; // Total duration in milliseconds
 
-  void runTest(const Test &test, int iterations) {
-    vector<double> times_us(iterations);
-    size_t input_size = test.input.size();
+  static double timeOnce(const Test &test) {
+    html2md::Options options = test.options;
+    auto start = high_resolution_clock::now();
+    string md = markdown::fromHTML(test.input, &options);
+    auto end = high_resolution_clock::now();
+    return duration<double, std::nano>(end - start).count();
+  }
 
-    for (int i = 0; i < iterations; ++i) {
-      auto start = high_resolution_clock::now();
-      if (test.is_markdown) {
-        markdown::toHTML(test.input);
-      } else {
-        string input_copy = test.input; // fromHTML modifies input
-        markdown::fromHTML(input_copy);
-      }
-      auto end = high_resolution_clock::now();
-      times_us[i] = duration<double, std::micro>(end - start).count();
+  static double percentile(const vector<double> &sorted, double p) {
+    size_t index = static_cast<size_t>(p * (sorted.size() - 1) + 0.5);
+    return sorted[std::min(index, sorted.size() - 1)];
+  }
+
+  void runTest(const Test &test) {
+    // Warm up caches and the allocator for ~10% of the measuring time, which
+    // also tells how many iterations fit into it
+    const double warmup_ns = settings_.min_time_s * 1e8;
+    double warmup_total_ns = 0.0;
+    size_t warmup_iterations = 0;
+    do {
+      warmup_total_ns += timeOnce(test);
+      ++warmup_iterations;
+    } while (warmup_total_ns < warmup_ns);
+
+    const double estimate_ns = warmup_total_ns / warmup_iterations;
+    size_t iterations = static_cast<size_t>(settings_.min_time_s * 1e9 /
+                                            std::max(estimate_ns, 1.0));
+    iterations = std::max<size_t>(iterations, settings_.min_iterations);
+    iterations = std::min<size_t>(iterations, 1000000);
+
+    vector<double> times_ns(iterations);
+    if (counters_)
+      counters_->start();
+    for (size_t i = 0; i < iterations; ++i)
+      times_ns[i] = timeOnce(test);
+    perf::Counters counters;
+    if (counters_)
+      counters = counters_->stop();
+
+    // Count the allocations of one more, untimed conversion
+    alloc::reset();
+    {
+      html2md::Options options = test.options;
+      string md = markdown::fromHTML(test.input, &options);
     }
+    alloc::Stats memory = alloc::get();
 
     // Calculate average and standard deviation
     double sum = 0.0;
-    for (double t : times_us)
+    for (double t : times_ns)
       sum += t;
-    double avg_time_us = sum / iterations;
+    double mean_ns = sum / iterations;
 
     double variance_sum = 0.0;
-    for (double t : times_us) {
-      variance_sum += (t - avg_time_us) * (t - avg_time_us);
+    for (double t : times_ns) {
+      variance_sum += (t - mean_ns) * (t - mean_ns);
     }
-    double std_dev_us = std::sqrt(variance_sum / iterations);
+    double std_dev_ns = std::sqrt(variance_sum / iterations);
+
+    std::sort(times_ns.begin(), times_ns.end());
 
     // Calculate throughput (MB/s)
-    double avg_time_s = avg_time_us / 1e6;
-    double throughput_mbps = (input_size / (1024.0 * 1024.0)) / avg_time_s;
+    double mean_s = mean_ns / 1e9;
+    double throughput_mbps = (test.input.size() / (1024.0 * 1024.0)) / mean_s;
 
-    results_.push_back(
-        {test.name, avg_time_us, std_dev_us, input_size, throughput_mbps});
+    results_.push_back({test.name, test.input.size(), iterations, mean_ns,
+                        std_dev_ns, percentile(times_ns, 0.5),
+                        percentile(times_ns, 0.9), percentile(times_ns, 0.99),
+                        throughput_mbps, 1.0 / mean_s, counters,
+                        iterations * test.input.size(), memory});
   }
 
   void printSummary() {
     cout << "\n=== Benchmark Summary ===\n";
-    cout << std::left << std::setw(30) << "Test Name" << std::setw(15)
-         << "Avg Time (us)" << std::setw(15) << "Std Dev (us)" << std::setw(15)
-         << "Input Size (B)" << std::setw(15) << "Throughput (MB/s)\n";
-    cout << std::string(90, '-') << "\n";
+    cout << std::left << std::setw(22) << "Test Name" << std::right
+         << std::setw(11) << "Size (B)" << std::setw(9) << "Iters"
+         << std::setw(12) << "Mean (us)" << std::setw(12) << "Std Dev"
+         << std::setw(12) << "p50 (us)" << std::setw(12) << "p90 (us)"
+         << std::setw(12) << "p99 (us)" << std::setw(10) << "MB/s"
+         << std::setw(12) << "docs/s"
+         << "\n";
+    cout << std::string(124, '-') << "\n";
 
     for (const auto &result : results_) {
-      cout << std::left << std::setw(30) << result.test_name << std::fixed
-           << std::setprecision(2) << std::setw(15) << result.avg_time_us
-           << std::setw(15) << result.std_dev_us << std::setw(15)
-           << result.input_size << std::setw(15) << result.throughput_mbps
+      cout << std::left << std::setw(22) << result.test_name << std::right
+           << std::setw(11) << result.input_size << std::setw(9)
+           << result.iterations << std::fixed << std::setprecision(2)
+           << std::setw(12) << result.mean_ns / 1e3 << std::setw(12)
+           << result.std_dev_ns / 1e3 << std::setw(12) << result.p50_ns / 1e3
+           << std::setw(12) << result.p90_ns / 1e3 << std::setw(12)
+           << result.p99_ns / 1e3 << std::setw(10) << result.throughput_mbps
+           << std::setprecision(0) << std::setw(12) << result.docs_per_s
            << "\n";
     }
 
+    printMemory();
+
+    if (counters_)
+      printCounters();
+
     cout << "\nTotal Benchmark Duration: " << std::fixed << std::setprecision(2)
          << total_duration_ms_ << " ms\n";
   }
+
+  static double nsPerByte(const BenchmarkResult &result) {
+    return result.p50_ns / std::max<size_t>(result.input_size, 1);
+  }
+
+  void printDocuments(size_t top) {
+    size_t total_bytes = 0;
+    double total_ns = 0.0;
+    for (const auto &result : results_) {
+      total_bytes += result.input_size;
+      total_ns += result.p50_ns;
+    }
+
+    vector<const BenchmarkResult *> slowest;
+    for (const auto &result : results_)
+      slowest.push_back(&result);
+    std::sort(slowest.begin(), slowest.end(), [](auto *a, auto *b) {
+      return nsPerByte(*a) > nsPerByte(*b);
+    });
+    slowest.resize(std::min(top, slowest.size()));
+
+    cout << "\n=== Documents ===\n"
+         << std::fixed << std::setprecision(2) << results_.size()
+         << " documents, " << total_bytes / (1024.0 * 1024.0) << " MB, "
+         << total_bytes / (1024.0 * 1024.0) / (total_ns / 1e9)
+         << " MB/s (sum of medians)\n";
+
+    cout << "\n=== " << slowest.size() << " Slowest Documents (ns/byte) ===\n";
+    cout << std::left << std::setw(40) << "Document" << std::right
+         << std::setw(12) << "Size (B)" << std::setw(12) << "ns/byte"
+         << std::setw(12) << "p50 (us)" << std::setw(10) << "MB/s"
+         << std::setw(14) << "Peak / Input"
+         << "\n";
+    cout << std::string(100, '-') << "\n";
+
+    for (const auto *result : slowest) {
+      // Keep the end of long paths, it's the more telling part
+      string name = result->test_name;
+      if (name.size() > 38)
+        name = "..." + name.substr(name.size() - 35);
+
+      cout << std::left << std::setw(40) << name << std::right << std::setw(12)
+           << result->input_size << std::setw(12) << nsPerByte(*result)
+           << std::setw(12) << result->p50_ns / 1e3 << std::setw(10)
+           << result->throughput_mbps << std::setw(14)
+           << static_cast<double>(result->memory.peak) / result->input_size
+           << "\n";
+    }
+
+    cout << "\nTotal Benchmark Duration: " << std::fixed << std::setprecision(2)
+         << total_duration_ms_ << " ms\n";
+  }
+
+  void printScaling() {
+    cout << "\n=== Scaling (" << tests_.size()
+         << " tests, per document latency) ===\n";
+    cout << std::left << std::setw(22) << "Threads" << std::right
+         << std::setw(10) << "Docs" << std::setw(12) << "MB/s" << std::setw(12)
+         << "docs/s" << std::setw(12) << "Efficiency" << std::setw(12)
+         << "p50 (us)" << std::setw(12) << "p90 (us)" << std::setw(12)
+         << "p99 (us)"
+         << "\n";
+    cout << std::string(104, '-') << "\n";
+
+    for (const auto &result : results_) {
+      cout << std::left << std::setw(22) << result.test_name << std::right
+           << std::setw(10) << result.iterations << std::fixed
+           << std::setprecision(2) << std::setw(12) << result.throughput_mbps
+           << std::setprecision(0) << std::setw(12) << result.docs_per_s
+           << std::setprecision(2) << std::setw(11)
+           << result.efficiency * 100.0 << "%" << std::setw(12)
+           << result.p50_ns / 1e3 << std::setw(12) << result.p90_ns / 1e3
+           << std::setw(12) << result.p99_ns / 1e3 << "\n";
+    }
+
+    cout << "\nTotal Benchmark Duration: " << std::fixed << std::setprecision(2)
+         << total_duration_ms_ << " ms\n";
+  }
+
+  void printMemory() {
+    cout << "\n=== Memory (per document) ===\n";
+    cout << std::left << std::setw(22) << "Test Name" << std::right
+         << std::setw(14) << "Allocations" << std::setw(16) << "Allocated (KB)"
+         << std::setw(14) << "Peak (KB)" << std::setw(14) << "Peak / Input"
+         << "\n";
+    cout << std::string(80, '-') << "\n";
+
+    for (const auto &result : results_) {
+      cout << std::left << std::setw(22) << result.test_name << std::right
+           << std::setw(14) << result.memory.allocations << std::fixed
+           << std::setprecision(1) << std::setw(16)
+           << result.memory.bytes / 1024.0 << std::setw(14)
+           << result.memory.peak / 1024.0 << std::setprecision(2)
+           << std::setw(14)
+           << static_cast<double>(result.memory.peak) / result.input_size
+           << "\n";
+    }
+  }
+
+  // Print a counter per byte, or "-" if the counter is not available
+  static void printPerByte(bool available, uint64_t value, size_t bytes) {
+    cout << std::setw(14);
+    if (available)
+      cout << std::setprecision(3) << static_cast<double>(value) / bytes;
+    else
+      cout << "-";
+  }
+
+  void printCounters() {
+    cout << "\n=== Hardware Counters (per input byte) ===\n";
+    cout << std::left << std::setw(22) << "Test Name" << std::right
+         << std::setw(14) << "Cycles" << std::setw(14) << "Instructions"
+         << std::setw(14) << "IPC" << std::setw(14) << "Branch Misses"
+         << std::setw(14) << "LLC Misses"
+         << "\n";
+    cout << std::string(92, '-') << "\n";
+
+    for (const auto &result : results_) {
+      const auto &c = result.counters;
+      cout << std::left << std::setw(22) << result.test_name << std::right
+           << std::fixed;
+      printPerByte(c.hasCycles, c.cycles, result.counted_bytes);
+      printPerByte(c.hasInstructions, c.instructions, result.counted_bytes);
+      cout << std::setw(14);
+      if (c.hasCycles && c.hasInstructions && c.cycles != 0)
+        cout << std::setprecision(2)
+             << static_cast<double>(c.instructions) / c.cycles;
+      else
+        cout << "-";
+      printPerByte(c.hasBranchMisses, c.branchMisses, result.counted_bytes);
+      printPerByte(c.hasCacheMisses, c.cacheMisses, result.counted_bytes);
+      cout << "\n";
+    }
+  }
 };
 
+// Reading and writing results as JSON. Each result is written on its own
+// line, which keeps the reader trivial.
+namespace json {
+bool write(const string &name, const vector<BenchmarkResult> &results) {
+  std::ofstream out(name);
+  if (!out)
+    return false;
+
+  out << "{\n  \"results\": [\n" << std::setprecision(17);
+  for (size_t i = 0; i < results.size(); ++i) {
+    const auto &r = results[i];
+    out << "    {\"name\": \"" << r.test_name
+        << "\", \"bytes\": " << r.input_size
+        << ", \"iterations\": " << r.iterations
+        << ", \"mean_ns\": " << r.mean_ns
+        << ", \"stddev_ns\": " << r.std_dev_ns
+        << ", \"p50_ns\": " << r.p50_ns << ", \"p90_ns\": " << r.p90_ns
+        << ", \"p99_ns\": " << r.p99_ns
+        << ", \"mb_per_s\": " << r.throughput_mbps
+        << ", \"docs_per_s\": " << r.docs_per_s;
+
+    if (r.memory.allocations != 0)
+      out << ", \"allocations\": " << r.memory.allocations
+          << ", \"allocated_bytes\": " << r.memory.bytes
+          << ", \"peak_bytes\": " << r.memory.peak << ", \"peak_ratio\": "
+          << static_cast<double>(r.memory.peak) / r.input_size;
+    if (r.efficiency != 0.0)
+      out << ", \"efficiency\": " << r.efficiency;
+
+    const auto &c = r.counters;
+    const double bytes = static_cast<double>(r.counted_bytes);
+    if (c.hasCycles)
+      out << ", \"cycles_per_byte\": " << c.cycles / bytes;
+    if (c.hasInstructions)
+      out << ", \"instructions_per_byte\": " << c.instructions / bytes;
+    if (c.hasCycles && c.hasInstructions && c.cycles != 0)
+      out << ", \"ipc\": " << static_cast<double>(c.instructions) / c.cycles;
+    if (c.hasBranchMisses)
+      out << ", \"branch_misses_per_byte\": " << c.branchMisses / bytes;
+    if (c.hasCacheMisses)
+      out << ", \"llc_misses_per_byte\": " << c.cacheMisses / bytes;
+
+    out << "}"
+        << (i + 1 < results.size() ? ",\n" : "\n");
+  }
+  out << "  ]\n}\n";
+
+  return static_cast<bool>(out);
+}
+
+// Extract the value of `key` from a line written by write()
+bool field(const string &line, const string &key, string *value) {
+  const string quoted = "\"" + key + "\": ";
+  size_t pos = line.find(quoted);
+  if (pos == string::npos)
+    return false;
+
+  pos += quoted.size();
+  if (line[pos] == '"') {
+    size_t end = line.find('"', pos + 1);
+    *value = line.substr(pos + 1, end - pos - 1);
+  } else {
+    size_t end = line.find_first_of(",}", pos);
+    *value = line.substr(pos, end - pos);
+  }
+  return true;
+}
+
+struct Baseline {
+  double p50_ns;
+  double peak_bytes; // 0 if not recorded
+};
+
+// Returns the baseline of every test by name
+std::map<string, Baseline> read(const string &name) {
+  std::map<string, Baseline> baselines;
+  ifstream in(name);
+  string line, test, p50, peak;
+
+  while (std::getline(in, line)) {
+    if (field(line, "name", &test) && field(line, "p50_ns", &p50)) {
+      if (!field(line, "peak_bytes", &peak))
+        peak = "0";
+      baselines[test] = {std::atof(p50.c_str()), std::atof(peak.c_str())};
+    }
+  }
+
+  return baselines;
+}
+} // namespace json
+
+// Percentage by which `current` exceeds `baseline`
+double change(double baseline, double current) {
+  return (current / baseline - 1.0) * 100.0;
+}
+
+// Compare the medians and peak memory against a baseline, returns the number
+// of regressions
+int compare(const vector<BenchmarkResult> &results, const string &baseline,
+            double threshold) {
+  auto baselines = json::read(baseline);
+  if (baselines.empty()) {
+    cerr << "No results found in " << baseline << "\n";
+    return -1;
+  }
+
+  cout << "\n=== Comparison with " << baseline << " (p50, threshold "
+       << threshold << "%) ===\n";
+  cout << std::left << std::setw(22) << "Test Name" << std::right
+       << std::setw(14) << "Baseline (us)" << std::setw(14) << "Current (us)"
+       << std::setw(10) << "Change" << std::setw(14) << "Peak Change"
+       << "\n";
+  cout << std::string(84, '-') << "\n";
+
+  int regressions = 0;
+  for (const auto &result : results) {
+    auto it = baselines.find(result.test_name);
+    if (it == baselines.end())
+      continue;
+
+    const auto &base = it->second;
+    double time_change = change(base.p50_ns, result.p50_ns);
+    double peak_change =
+        base.peak_bytes > 0 ? change(base.peak_bytes, result.memory.peak) : 0;
+
+    const char *verdict = "";
+    if (time_change > threshold || peak_change > threshold) {
+      verdict = "  REGRESSION";
+      ++regressions;
+    } else if (time_change < -threshold || peak_change < -threshold) {
+      verdict = "  improved";
+    }
+
+    cout << std::left << std::setw(22) << result.test_name << std::right
+         << std::fixed << std::setprecision(2) << std::setw(14)
+         << base.p50_ns / 1e3 << std::setw(14) << result.p50_ns / 1e3
+         << std::setw(9) << std::showpos << time_change << "%" << std::setw(13)
+         << peak_change << std::noshowpos << "%" << verdict << "\n";
+  }
+
+  cout << "\n" << regressions << " regression(s)\n";
+  return regressions;
+}
+
 namespace file {
 string readAll(const string &name) {
   ifstream in(name);
@@ -151,34 +642,292 @@ string readAll(const string &name) {
 }
 } // namespace file
 
-int main() {
-  using namespace markdown;
-  BenchmarkRunner runner;
-  const int iterations = 10000; // Number of iterations per test
+vector<string> split(const string &list) {
+  vector<string> items;
+  stringstream in(list);
+  string item;
+  while (std::getline(in, item, ','))
+    if (!item.empty())
+      items.push_back(item);
+  return items;
+}
+
+// Set a field of Options from "name=value"
+bool setOption(const string &assignment, html2md::Options *options) {
+  size_t equals = assignment.find('=');
+  if (equals == string::npos || equals + 1 == assignment.size())
+    return false;
+
+  const string name = assignment.substr(0, equals);
+  const string value = assignment.substr(equals + 1);
+  const bool flag = value == "1" || value == "true" || value == "on";
+
+  if (name == "splitLines")
+    options->splitLines = flag;
+  else if (name == "softBreak")
+    options->softBreak = std::atoi(value.c_str());
+  else if (name == "hardBreak")
+    options->hardBreak = std::atoi(value.c_str());
+  else if (name == "unorderedList")
+    options->unorderedList = value[0];
+  else if (name == "orderedList")
+    options->orderedList = value[0];
+  else if (name == "includeTitle")
+    options->includeTitle = flag;
+  else if (name == "formatTable")
+    options->formatTable = flag;
+  else if (name == "forceLeftTrim")
+    options->forceLeftTrim = flag;
+  else if (name == "compressWhitespace")
+    options->compressWhitespace = flag;
+  else if (name == "escapeNumberedList")
+    options->escapeNumberedList = flag;
+  else if (name == "escapeMarkdown")
+    options->escapeMarkdown = flag;
+  else if (name == "keepHtmlEntities")
+    options->keepHtmlEntities = flag;
+  else if (name == "threads")
+    options->threads = static_cast<unsigned>(std::atoi(value.c_str()));
+  else
+    return false;
 
-  // Add tests for Markdown files in the directory
-  vector<string> files;
-  static vector<string> markdownExtensions = {".md", ".markdown", ".mkd"};
-  for (const auto &p : fs::recursive_directory_iterator(DIR)) {
-    if (std::find(markdownExtensions.begin(), markdownExtensions.end(),
-                  p.path().extension()) != markdownExtensions.end() &&
-        p.path().parent_path() == DIR) {
-      files.emplace_back(p.path().string());
+  return true;
+}
+
+void printHelp(const char *program) {
+  cout << "Usage: " << program << " [options]\n\n"
+       << "Options:\n"
+       << "  --sizes LIST       Corpus sizes, e.g. 1K,64K,1M,100M (default: "
+          "1K,64K,1M,\n"
+       << "                     and 100,4K for fragments)\n"
+       << "  --shapes LIST      Corpus shapes, any of: ";
+  for (auto shape : corpus::shapes())
+    cout << corpus::name(shape) << " ";
+  cout << "\n"
+       << "  --min-time SEC     Measure each test for at least SEC seconds "
+          "(default: 0.5,\n"
+       << "                     0.05 with --dir or --list)\n"
+       << "  --no-files         Skip the tests/*.md based tests\n"
+       << "  --perf             Report hardware counters (Linux "
+          "perf_event_open)\n"
+       << "  --threads N        Convert all tests on 1, 2, 4, ... N threads "
+          "at once and\n"
+       << "                     report the scaling (0: number of cores)\n"
+       << "  --dir DIR          Convert the .html/.htm files in DIR "
+          "(recursive) instead\n"
+       << "                     of the corpus\n"
+       << "  --list FILE        Convert the HTML files listed in FILE, one "
+          "per line\n"
+       << "  --top N            Number of slowest documents shown with --dir "
+          "or --list\n"
+       << "                     (default: 10)\n"
+       << "  --option NAME=VAL  Set a converter option, e.g. softBreak=80 "
+          "(repeatable)\n"
+       << "  --kernels          Run every test with each combination of "
+          "splitLines and\n"
+       << "                     compressWhitespace\n"
+       << "  --json FILE        Write the results as JSON to FILE\n"
+       << "  --compare FILE     Compare against a baseline written by --json\n"
+       << "  --threshold PCT    Slowdown of the median counted as regression "
+          "(default: 10)\n";
+}
+
+bool parseArguments(int argc, char **argv, Settings *settings) {
+  for (int i = 1; i < argc; ++i) {
+    string arg = argv[i];
+    bool has_value = i + 1 < argc;
+
+    if (arg == "-h" || arg == "--help") {
+      printHelp(argv[0]);
+      exit(0);
+    } else if (arg == "--no-files") {
+      settings->files = false;
+    } else if (arg == "--kernels") {
+      settings->kernels = true;
+    } else if (arg == "--perf") {
+      settings->perf = true;
+    } else if (!has_value) {
+      cerr << "Unknown option or missing value: " << arg << "\n";
+      return false;
+    } else if (arg == "--sizes") {
+      settings->sizes.clear();
+      settings->fragment_sizes.clear();
+      for (const auto &size : split(argv[++i])) {
+        size_t bytes = corpus::parseSize(size);
+        if (bytes == 0) {
+          cerr << "Invalid size: " << size << "\n";
+          return false;
+        }
+        settings->sizes.push_back(bytes);
+      }
+    } else if (arg == "--shapes") {
+      settings->shapes.clear();
+      for (const auto &name : split(argv[++i])) {
+        auto shapes = corpus::shapes();
+        auto it = std::find_if(shapes.begin(), shapes.end(), [&](auto shape) {
+          return name == corpus::name(shape);
+        });
+        if (it == shapes.end()) {
+          cerr << "Unknown shape: " << name << "\n";
+          return false;
+        }
+        settings->shapes.push_back(*it);
+      }
+    } else if (arg == "--min-time") {
+      settings->min_time_s = std::atof(argv[++i]);
+    } else if (arg == "--threads") {
+      int threads = std::atoi(argv[++i]);
+      if (threads <= 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+      settings->threads = threads;
+    } else if (arg == "--dir") {
+      fs::path dir = argv[++i];
+      std::error_code error;
+      for (auto it = fs::recursive_directory_iterator(dir, error);
+           it != fs::recursive_directory_iterator(); it.increment(error)) {
+        auto extension = it->path().extension();
+        if (it->is_regular_file() && (extension == ".html" || extension == ".htm"))
+          settings->documents.push_back(it->path().string());
+      }
+      if (error) {
+        cerr << "Failed to read " << dir << ": " << error.message() << "\n";
+        return false;
+      }
+    } else if (arg == "--list") {
+      ifstream list(argv[++i]);
+      if (!list) {
+        cerr << "Failed to open " << argv[i] << "\n";
+        return false;
+      }
+      for (string line; std::getline(list, line);)
+        if (!line.empty() && line[0] != '#')
+          settings->documents.push_back(line);
+    } else if (arg == "--top") {
+      settings->top = std::strtoul(argv[++i], nullptr, 10);
+    } else if (arg == "--option") {
+      if (!setOption(argv[++i], &markdown::options)) {
+        cerr << "Invalid option: " << argv[i] << "\n";
+        return false;
+      }
+    } else if (arg == "--json") {
+      settings->json = argv[++i];
+    } else if (arg == "--compare") {
+      settings->compare = argv[++i];
+    } else if (arg == "--threshold") {
+      settings->threshold = std::atof(argv[++i]);
+    } else {
+      cerr << "Unknown option: " << arg << "\n";
+      return false;
     }
   }
-  std::sort(files.begin(), files.end());
 
-  for (const auto &file : files) {
-    string md = file::readAll(file);
-    string html = markdown::toHTML(md);
-    string filename = fs::path(file).filename().string();
-    runner.addTest(filename, html, false);
+  return true;
+}
+
+int main(int argc, char **argv) {
+  Settings settings;
+  if (!parseArguments(argc, argv, &settings)) {
+    printHelp(argv[0]);
+    return 2;
+  }
+
+  const bool documents = !settings.documents.empty();
+  if (settings.min_time_s < 0)
+    settings.min_time_s = documents ? 0.05 : 0.5;
+
+  BenchmarkRunner runner(settings);
+
+  // With --kernels every test is added once for each combination of the
+  // options that select the tokenizer kernel, others as given by --option
+  auto add = [&](const string &name, string input) {
+    if (!settings.kernels) {
+      runner.addTest(name, std::move(input));
+      return;
+    }
+
+    for (int kernel = 0; kernel < 4; ++kernel) {
+      html2md::Options options = markdown::options;
+      options.splitLines = kernel & 1;
+      options.compressWhitespace = kernel & 2;
+
+      static const char *const labels[] = {"plain", "split", "ws",
+                                           "split+ws"};
+      runner.addTest(name + " " + labels[kernel], input, options);
+    }
+  };
+
+  // Add the given documents, or the tests for Markdown files in the directory
+  // and the generated corpus
+  for (const auto &document : settings.documents) {
+    string html = file::readAll(document);
+    if (html.empty()) {
+      cerr << "Skipping empty or unreadable " << document << "\n";
+      continue;
+    }
+    add(document, std::move(html));
+  }
+
+  if (settings.files && !documents) {
+    vector<string> files;
+    static vector<string> markdownExtensions = {".md", ".markdown", ".mkd"};
+    for (const auto &p : fs::recursive_directory_iterator(DIR)) {
+      if (std::find(markdownExtensions.begin(), markdownExtensions.end(),
+                    p.path().extension()) != markdownExtensions.end() &&
+          p.path().parent_path() == DIR) {
+        files.emplace_back(p.path().string());
+      }
+    }
+    std::sort(files.begin(), files.end());
+
+    for (const auto &file : files) {
+      string md = file::readAll(file);
+      string filename = fs::path(file).filename().string();
+      add(filename, markdown::toHTML(md));
+    }
+  }
+
+  for (auto shape : documents ? vector<corpus::Shape>() : settings.shapes) {
+    vector<size_t> sizes = settings.sizes;
+    if (shape == corpus::Shape::Fragment) {
+      sizes.insert(sizes.end(), settings.fragment_sizes.begin(),
+                   settings.fragment_sizes.end());
+      std::sort(sizes.begin(), sizes.end());
+      sizes.erase(std::unique(sizes.begin(), sizes.end()), sizes.end());
+    }
+
+    for (size_t size : sizes) {
+      add(string(corpus::name(shape)) + "/" + corpus::formatSize(size),
+          corpus::generate(shape, size));
+    }
   }
 
   // Run benchmarks
-  cout << "Running benchmarks with " << iterations
-       << " iterations per test...\n";
-  runner.run(iterations);
+  if (settings.threads != 0) {
+    cout << "Running scaling benchmark for " << settings.min_time_s
+         << " s per thread count...\n";
+    runner.runScaling(settings.threads);
+  } else if (documents) {
+    cout << "Converting " << settings.documents.size()
+         << " documents for at least " << settings.min_time_s
+         << " s each...\n";
+    runner.runDocuments(settings.top);
+  } else {
+    cout << "Running benchmarks for at least " << settings.min_time_s
+         << " s per test...\n";
+    runner.run();
+  }
+
+  if (!settings.json.empty() && !json::write(settings.json, runner.results())) {
+    cerr << "Failed to write " << settings.json << "\n";
+    return 2;
+  }
+
+  if (!settings.compare.empty()) {
+    int regressions =
+        compare(runner.results(), settings.compare, settings.threshold);
+    if (regressions != 0)
+      return regressions < 0 ? 2 : 1;
+  }
 
   return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,386 @@
+// Copyright (c) Tim Gromeyer
+// Licensed under the MIT License - https://opensource.org/licenses/MIT
+
+#include "corpus.h"
+
+#include <cctype>
+#include <cstdlib>
+
+using std::string;
+using std::vector;
+
+namespace {
+const char *const kWords[] = {
+    "the",      "of",       "and",         "to",        "in",
+    "is",       "that",     "for",         "it",        "as",
+    "with",     "was",      "on",          "be",        "by",
+    "this",     "are",      "from",        "or",        "have",
+    "server",   "request",  "document",    "markdown",  "converter",
+    "table",    "release",  "performance", "memory",    "latency",
+    "council",  "weather",  "market",      "election",  "research",
+    "function", "value",    "returns",     "parameter", "option",
+    "über",     "naïve",    "東京",        "données",   "résumé",
+};
+
+// Small, fast and reproducible; quality does not matter here
+class Random {
+public:
+  explicit Random(uint32_t seed) : state_(seed * 2654435761u + 1) {}
+
+  uint32_t next() {
+    state_ ^= state_ << 13;
+    state_ ^= state_ >> 17;
+    state_ ^= state_ << 5;
+    return state_;
+  }
+
+  size_t below(size_t n) { return next() % n; }
+
+  bool chance(size_t percent) { return below(100) < percent; }
+
+private:
+  uint32_t state_;
+};
+
+class Generator {
+public:
+  Generator(size_t size, uint32_t seed) : size_(size), random_(seed) {
+    out_.reserve(size + size / 8 + 256);
+  }
+
+  bool full() const { return out_.size() >= size_; }
+
+  string take() { return std::move(out_); }
+
+  Generator &operator<<(const string &str) {
+    out_ += str;
+    return *this;
+  }
+
+  Generator &operator<<(const char *str) {
+    out_ += str;
+    return *this;
+  }
+
+  Generator &operator<<(size_t number) {
+    out_ += std::to_string(number);
+    return *this;
+  }
+
+  Random &random() { return random_; }
+
+  const char *word() {
+    return kWords[random_.below(sizeof(kWords) / sizeof(*kWords))];
+  }
+
+  // Plain words separated by spaces
+  void words(size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+      if (i != 0)
+        out_ += ' ';
+      out_ += word();
+    }
+  }
+
+  // A sentence with occasional inline markup
+  void sentence() {
+    size_t count = 6 + random_.below(14);
+    for (size_t i = 0; i < count; ++i) {
+      if (i != 0)
+        out_ += ' ';
+
+      switch (random_.below(20)) {
+      case 0:
+        *this << "<strong>" << word() << "</strong>";
+        break;
+      case 1:
+        *this << "<em>" << word() << "</em>";
+        break;
+      case 2:
+        *this << "<a href=\"https://example.com/" << word() << "/"
+              << random_.below(1000) << "\">" << word() << " " << word()
+              << "</a>";
+        break;
+      case 3:
+        *this << "<code>" << word() << "()</code>";
+        break;
+      default:
+        out_ += word();
+      }
+    }
+    out_ += ". ";
+  }
+
+  void paragraph(size_t sentences) {
+    out_ += "<p>";
+    for (size_t i = 0; i < sentences; ++i)
+      sentence();
+    out_ += "</p>\n";
+  }
+
+private:
+  size_t size_;
+  Random random_;
+  string out_;
+};
+
+void head(Generator &g, const char *title, size_t script_bytes) {
+  g << "<!DOCTYPE html>\n<html lang=\"en\">\n<head>\n<meta charset=\"utf-8\">\n"
+    << "<title>" << title << "</title>\n"
+    << "<style>body { font-family: sans-serif; } .hidden { display: none; }"
+       "</style>\n<script>";
+  for (size_t i = 0; i < script_bytes; i += 64)
+    g << "window.app = window.app || {}; app.init = function(a) { return a < 1; };\n";
+  g << "</script>\n</head>\n<body>\n";
+}
+
+void fragment(Generator &g) {
+  while (!g.full()) {
+    switch (g.random().below(4)) {
+    case 0:
+      g << "<p>Hey, did you see the <b>new</b> " << g.word() << "?</p>";
+      break;
+    case 1:
+      g << "<p>Check <a href=\"https://example.com/" << g.word() << "\">"
+        << g.word() << "</a> &amp; <code>" << g.word() << "</code>.</p>";
+      break;
+    case 2:
+      g << "<ul><li>" << g.word() << "</li><li>" << g.word() << "</li></ul>";
+      break;
+    default:
+      g << "<blockquote>" << g.word() << " " << g.word() << "</blockquote>";
+    }
+  }
+}
+
+void news(Generator &g) {
+  head(g, "Breaking news", 512);
+  g << "<nav><ul><li><a href=\"/\">Home</a></li><li><a href=\"/world\">World"
+       "</a></li></ul></nav>\n<article>\n<h1>";
+  g.words(8);
+  g << "</h1>\n";
+
+  while (!g.full()) {
+    switch (g.random().below(8)) {
+    case 0:
+      g << "<h2>";
+      g.words(5);
+      g << "</h2>\n";
+      break;
+    case 1:
+      g << "<figure><img src=\"https://img.example.com/" << g.random().below(1000)
+        << ".jpg\" alt=\"";
+      g.words(4);
+      g << "\" title=\"" << g.word() << "\"></figure>\n";
+      break;
+    case 2:
+      g << "<blockquote><p>";
+      g.sentence();
+      g << "</p></blockquote>\n";
+      break;
+    default:
+      g.paragraph(2 + g.random().below(4));
+    }
+  }
+
+  g << "</article>\n</body>\n</html>\n";
+}
+
+void docs(Generator &g) {
+  head(g, "API reference", 256);
+  g << "<nav class=\"sidebar\"><ul>";
+  for (int i = 0; i < 20; ++i)
+    g << "<li><a href=\"#s" << size_t(i) << "\">" << g.word() << "</a></li>";
+  g << "</ul></nav>\n<main>\n";
+
+  for (size_t section = 0; !g.full(); ++section) {
+    g << "<h2 id=\"s" << section << "\">" << g.word() << "::" << g.word()
+      << "()</h2>\n";
+    g.paragraph(2);
+
+    g << "<pre><code class=\"language-cpp\">";
+    size_t lines = 3 + g.random().below(10);
+    for (size_t i = 0; i < lines; ++i)
+      g << "  auto " << g.word() << " = converter." << g.word() << "(*ptr, "
+        << i << "); // a < b && c > d\n";
+    g << "</code></pre>\n";
+
+    g << "<ul>\n";
+    for (size_t i = 0; i < 4; ++i) {
+      g << "<li><code>" << g.word() << "</code>: ";
+      g.words(6);
+      g << "</li>\n";
+    }
+    g << "</ul>\n";
+  }
+
+  g << "</main>\n</body>\n</html>\n";
+}
+
+void tableReport(Generator &g) {
+  head(g, "Quarterly report", 128);
+
+  while (!g.full()) {
+    g << "<h2>";
+    g.words(3);
+    g << "</h2>\n<table>\n<thead><tr><th align=\"left\">Region</th>"
+         "<th align=\"right\">Q1</th><th align=\"right\">Q2</th>"
+         "<th align=\"right\">Q3</th><th align=\"center\">Trend</th></tr>"
+         "</thead>\n<tbody>\n";
+
+    size_t rows = 20 + g.random().below(80);
+    for (size_t i = 0; i < rows; ++i) {
+      g << "<tr><td>" << g.word() << "</td>";
+      for (int q = 0; q < 3; ++q)
+        g << "<td>" << g.random().below(100000) << "</td>";
+      g << "<td>" << (g.random().chance(50) ? "up" : "down") << "</td></tr>\n";
+    }
+
+    g << "</tbody>\n</table>\n";
+  }
+
+  g << "</body>\n</html>\n";
+}
+
+void spaShell(Generator &g) {
+  // Nearly all of the page is inline script
+  g <<"<!DOCTYPE html>\n<html>\n<head>\n<title>App</title>\n";
+  g << "<noscript>You need to enable JavaScript to run this app.</noscript>\n";
+  g << "<div id=\"root\"><p>Loading ";
+  g.words(4);
+  g << "</p></div>\n<script>";
+  while (!g.full())
+    g << "!function(e){var t={};function n(r){if(t[r])return t[r].exports;"
+         "var o=t[r]={i:r,l:!1,exports:{}};return e[r].call(o.exports,o,o."
+         "exports,n),o.l=!0,o.exports}n.m=e,n.c=t}([]);\n";
+  g << "</script>\n</head>\n<body></body>\n</html>\n";
+}
+
+void entities(Generator &g) {
+  static const char *const kSpecial[] = {
+      "&amp;", "&lt;", "&gt;",  "&quot;", "&nbsp;", "&rarr;", "&#169;",
+      "*",     "`",    "\\",    "_",      "[",      "]",      "1.",
+  };
+
+  while (!g.full()) {
+    g << "<p>";
+    size_t count = 20 + g.random().below(20);
+    for (size_t i = 0; i < count; ++i) {
+      if (g.random().chance(40))
+        g << kSpecial[g.random().below(sizeof(kSpecial) / sizeof(*kSpecial))];
+      else
+        g << g.word();
+      g << " ";
+    }
+    g << "</p>\n";
+  }
+}
+
+void nestedLists(Generator &g) {
+  while (!g.full()) {
+    size_t depth = 1 + g.random().below(6);
+    for (size_t d = 0; d < depth; ++d) {
+      g << "<ul>\n<li>";
+      g.words(3);
+      g << "</li>\n";
+    }
+    for (size_t d = 0; d < depth; ++d) {
+      g << "<li>";
+      g.words(4);
+      g << "</li>\n</ul>\n";
+    }
+  }
+}
+} // namespace
+
+namespace corpus {
+
+const vector<Shape> &shapes() {
+  static const vector<Shape> all = {
+      Shape::Fragment,    Shape::News,     Shape::Docs,
+      Shape::TableReport, Shape::SpaShell, Shape::Entities,
+      Shape::NestedLists,
+  };
+  return all;
+}
+
+const char *name(Shape shape) {
+  switch (shape) {
+  case Shape::Fragment:
+    return "fragment";
+  case Shape::News:
+    return "news";
+  case Shape::Docs:
+    return "docs";
+  case Shape::TableReport:
+    return "tables";
+  case Shape::SpaShell:
+    return "spa";
+  case Shape::Entities:
+    return "entities";
+  case Shape::NestedLists:
+    return "lists";
+  }
+  return "";
+}
+
+string generate(Shape shape, size_t size, uint32_t seed) {
+  Generator g(size, seed);
+
+  switch (shape) {
+  case Shape::Fragment:
+    fragment(g);
+    break;
+  case Shape::News:
+    news(g);
+    break;
+  case Shape::Docs:
+    docs(g);
+    break;
+  case Shape::TableReport:
+    tableReport(g);
+    break;
+  case Shape::SpaShell:
+    spaShell(g);
+    break;
+  case Shape::Entities:
+    entities(g);
+    break;
+  case Shape::NestedLists:
+    nestedLists(g);
+    break;
+  }
+
+  return g.take();
+}
+
+size_t parseSize(const string &str) {
+  char *end = nullptr;
+  unsigned long long value = strtoull(str.c_str(), &end, 10);
+
+  if (end == str.c_str())
+    return 0;
+
+  switch (toupper(static_cast<unsigned char>(*end))) {
+  case '\0':
+    return value;
+  case 'K':
+    return value * 1024;
+  case 'M':
+    return value * 1024 * 1024;
+  case 'G':
+    return value * 1024 * 1024 * 1024;
+  default:
+    return 0;
+  }
+}
+
+string formatSize(size_t size) {
+  if (size >= 1024 * 1024 && size % (1024 * 1024) == 0)
+    return std::to_string(size / (1024 * 1024)) + "M";
+  if (size >= 1024 && size % 1024 == 0)
+    return std::to_string(size / 1024) + "K";
+  return std::to_string(size);
+}
+
+} // namespace corpus
@@ -0,0 +1,43 @@
+// Copyright (c) Tim Gromeyer
+// Licensed under the MIT License - https://opensource.org/licenses/MIT
+
+#ifndef CORPUS_H
+#define CORPUS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Synthetic HTML documents shaped like real pages, for benchmarks and fuzzing
+namespace corpus {
+
+enum class Shape {
+  Fragment,    // Chat message or comment: a few inline tags
+  News,        // Article: headings, paragraphs, links, images, quotes
+  Docs,        // Documentation: navigation, inline code, code blocks, lists
+  TableReport, // Report made of large tables
+  SpaShell,    // Single page app shell: mostly inline <script>
+  Entities,    // Text dense with entities and chars that need escaping
+  NestedLists, // Deeply nested lists
+};
+
+// All shapes, in the order above
+const std::vector<Shape> &shapes();
+
+// Short name of the shape, e.g. "news"
+const char *name(Shape shape);
+
+// Generate a document of the given shape with roughly `size` bytes.
+// The same shape, size and seed always give the same document.
+std::string generate(Shape shape, size_t size, uint32_t seed = 1);
+
+// Parse sizes like "100", "64K" or "100M"; returns 0 if invalid
+size_t parseSize(const std::string &str);
+
+// Format a size like "64K" or "100M"
+std::string formatSize(size_t size);
+
+} // namespace corpus
+
+#endif // CORPUS_H
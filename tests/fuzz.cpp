@@ -0,0 +1,188 @@
+// Copyright (c) Tim Gromeyer
+// Licensed under the MIT License - https://opensource.org/licenses/MIT
+
+// Fuzz target for html2md::Converter, for libFuzzer and AFL.
+//
+// Besides crashes, a conversion that takes much longer than the length of its
+// input allows is reported (by aborting), to find inputs with superlinear
+// run time. The budget is
+//
+//   HTML2MD_FUZZ_BASE_MS (default 20) + HTML2MD_FUZZ_NS_PER_BYTE (default
+//   20000) * input length
+//
+// which is far above the normal cost of a conversion even in a sanitized
+// build. A conversion over budget is repeated once, so a hiccup of the machine
+// doesn't count as a finding.
+//
+// The first byte of the input selects the Options, the second how the HTML is
+// converted (see Mode), the rest is the HTML. Every way but
+// Converter::convert() must give the same Markdown as it, else the target
+// aborts too.
+//
+// Without HTML2MD_LIBFUZZER a main() is provided that runs the target on the
+// given files or on stdin, for AFL and for reproducing findings.
+
+#include "html2md.h"
+#include "html2md_c.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+namespace {
+double envOr(const char *name, double fallback) {
+  const char *value = getenv(name);
+  return value != nullptr ? atof(value) : fallback;
+}
+
+html2md::Options optionsFrom(uint8_t flags) {
+  html2md::Options options;
+  options.splitLines = flags & 0x01;
+  options.formatTable = flags & 0x02;
+  options.forceLeftTrim = flags & 0x04;
+  options.compressWhitespace = flags & 0x08;
+  options.escapeNumberedList = flags & 0x10;
+  options.keepHtmlEntities = flags & 0x20;
+  options.includeTitle = flags & 0x40;
+  options.escapeMarkdown = flags & 0x80;
+  return options;
+}
+
+// The low two bits of the second byte. The bits above select
+// Options::unorderedList and the chunk size of kFeed and kCApi.
+enum Mode : uint8_t {
+  kConvert,
+  kThreads, // Options::threads, only large inputs are converted in parallel
+  kFeed,    // Converter::feed() in chunks, flush() after each one
+  kCApi,    // html2md_feed() in chunks, then html2md_finish()
+};
+
+std::string convertCApi(const std::string &html,
+                        const html2md::Options &options, size_t chunk) {
+  html2md_options c_options;
+  c_options.struct_size = sizeof(c_options);
+  html2md_options_init(&c_options);
+  c_options.split_lines = options.splitLines;
+  c_options.format_table = options.formatTable;
+  c_options.force_left_trim = options.forceLeftTrim;
+  c_options.compress_whitespace = options.compressWhitespace;
+  c_options.escape_numbered_list = options.escapeNumberedList;
+  c_options.keep_html_entities = options.keepHtmlEntities;
+  c_options.include_title = options.includeTitle;
+  c_options.escape_markdown = options.escapeMarkdown;
+  c_options.unordered_list = options.unorderedList;
+
+  html2md_engine *engine = html2md_engine_new(&c_options);
+  for (size_t i = 0; i < html.size(); i += chunk)
+    html2md_feed(engine, html.data() + i, std::min(chunk, html.size() - i));
+
+  const char *data = nullptr;
+  size_t size = 0;
+  html2md_finish(engine, nullptr, 0, nullptr);
+  html2md_output(engine, &data, &size);
+  std::string md(data, size);
+  html2md_engine_free(engine);
+  return md;
+}
+
+std::string convert(const std::string &html, html2md::Options options,
+                    uint8_t mode) {
+  const size_t chunk = 1 + (mode >> 3) * 16;
+
+  switch (mode & 0x03) {
+  case kThreads:
+    options.threads = 4;
+    break;
+  case kFeed: {
+    html2md::Converter converter("", &options);
+    std::string md;
+    for (size_t i = 0; i < html.size(); i += chunk) {
+      converter.feed(html.data() + i, std::min(chunk, html.size() - i));
+      md += converter.flush();
+    }
+    return md + converter.finish();
+  }
+  case kCApi:
+    return convertCApi(html, options, chunk);
+  }
+
+  html2md::Converter converter(html, &options);
+  return converter.convert();
+}
+
+// Nanoseconds it took to convert html, the Markdown is stored in *md
+double timeConvert(const std::string &html, const html2md::Options &options,
+                   uint8_t mode, std::string *md) {
+  auto start = std::chrono::steady_clock::now();
+  *md = convert(html, options, mode);
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::nano>(end - start).count();
+}
+} // namespace
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+  if (size < 2)
+    return 0;
+
+  static const double base_ns = envOr("HTML2MD_FUZZ_BASE_MS", 20) * 1e6;
+  static const double ns_per_byte = envOr("HTML2MD_FUZZ_NS_PER_BYTE", 20000);
+
+  html2md::Options options = optionsFrom(data[0]);
+  const uint8_t mode = data[1];
+  options.unorderedList = mode & 0x04 ? '*' : '-';
+  const std::string html(reinterpret_cast<const char *>(data) + 2, size - 2);
+  const double budget_ns = base_ns + ns_per_byte * html.size();
+
+  std::string md;
+  double ns = timeConvert(html, options, mode, &md);
+  if (ns > budget_ns &&
+      (ns = timeConvert(html, options, mode, &md)) > budget_ns) {
+    fprintf(stderr,
+            "html2md: converting %zu bytes took %.1f ms, the budget is %.1f ms "
+            "(%.0f ns/byte)\n",
+            html.size(), ns / 1e6, budget_ns / 1e6, ns / html.size());
+    abort();
+  }
+
+  if ((mode & 0x03) != kConvert && md != convert(html, options, kConvert)) {
+    fprintf(stderr, "html2md: mode %d gives other Markdown than convert()\n",
+            mode & 0x03);
+    abort();
+  }
+
+  return 0;
+}
+
+#ifndef HTML2MD_LIBFUZZER
+int main(int argc, char **argv) {
+  auto run = [](std::istream &in) {
+    std::stringstream buffer;
+    buffer << in.rdbuf();
+    const std::string data = buffer.str();
+    LLVMFuzzerTestOneInput(reinterpret_cast<const uint8_t *>(data.data()),
+                           data.size());
+  };
+
+  if (argc < 2) {
+    run(std::cin);
+    return 0;
+  }
+
+  for (int i = 1; i < argc; ++i) {
+    std::ifstream file(argv[i], std::ios::binary);
+    if (!file) {
+      std::cerr << "Failed to open " << argv[i] << "\n";
+      return 1;
+    }
+    run(file);
+  }
+
+  return 0;
+}
+#endif
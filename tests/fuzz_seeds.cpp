@@ -0,0 +1,82 @@
+// Copyright (c) Tim Gromeyer
+// Licensed under the MIT License - https://opensource.org/licenses/MIT
+
+// Writes a seed corpus for fuzz.cpp: the HTML of the Markdown files in this
+// dir (via md4c) and small documents of every corpus shape.
+
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include "corpus.h"
+#include "md4c-html.h"
+
+using std::string;
+namespace fs = std::filesystem;
+
+namespace {
+// First byte of every seed, selects the Options in fuzz.cpp: splitLines,
+// formatTable, escapeNumberedList and includeTitle
+constexpr char kDefaultOptions = 0x53;
+
+// Second byte of every seed, selects how fuzz.cpp converts: feed() in chunks
+// of 65 bytes
+constexpr char kDefaultMode = 0x22;
+
+// Inputs that crashed once
+const char *const kRegressions[] = {
+    "<blockquote><table></blockquote></table>",
+    "x<ol>",
+};
+
+void captureHtmlFragment(const MD_CHAR *data, const MD_SIZE data_size,
+                         void *userData) {
+  static_cast<string *>(userData)->append(data, data_size);
+}
+
+bool write(const fs::path &path, const string &html) {
+  std::ofstream out(path, std::ios::binary);
+  out << kDefaultOptions << kDefaultMode << html;
+  return static_cast<bool>(out);
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  if (argc != 2) {
+    std::cerr << "Usage: " << argv[0] << " OUTPUT_DIR\n";
+    return 2;
+  }
+
+  const fs::path out = argv[1];
+  fs::create_directories(out);
+  size_t seeds = 0;
+
+  for (const auto &entry : fs::directory_iterator(DIR)) {
+    if (entry.path().extension() != ".md")
+      continue;
+
+    std::ifstream in(entry.path());
+    std::stringstream md;
+    md << in.rdbuf();
+
+    string html;
+    static MD_TOC_OPTIONS options;
+    md_html(md.str().c_str(), md.str().size(), &captureHtmlFragment, &html,
+            MD_DIALECT_GITHUB, MD_HTML_FLAG_SKIP_UTF8_BOM, &options);
+
+    seeds += write(out / entry.path().stem().concat(".html"), html);
+  }
+
+  for (auto shape : corpus::shapes())
+    seeds += write(out / (string(corpus::name(shape)) + ".html"),
+                   corpus::generate(shape, 4096));
+
+  for (size_t i = 0; i < sizeof(kRegressions) / sizeof(*kRegressions); ++i)
+    seeds += write(out / ("regression-" + std::to_string(i) + ".html"),
+                   kRegressions[i]);
+
+  std::cout << "Wrote " << seeds << " seeds to " << out << "\n";
+  return 0;
+}
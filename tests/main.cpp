@@ -8,6 +8,7 @@
 #include <vector>
 
 #include "html2md.h"
+#include "html2md_c.h"
 #include "md4c-html.h"
 #include "table.h"
 
@@ -352,6 +353,78 @@ bool testWhitespaceTags() {
   return true;
 }
 
+bool testQuotedGreaterThan() {
+  testOption("quotedGreaterThan");
+
+  // A '>' inside a quoted attribute value doesn't end the tag
+  vector<std::pair<string, string>> testCases = {
+      {"<a href=\"a>b\">link</a>", "[link](a>b)\n"},
+      {"<a href='a>b'>link</a>", "[link](a>b)\n"},
+      {"<a href=\"x\" title='1 > 0'>link</a>", "[link](x \"1 > 0\")\n"},
+      {"<img src='a>b.png' alt=\"x/y\"/>", "![x/y](a>b.png)\n"}};
+
+  for (const auto &[html, expectedMd] : testCases) {
+    html2md::Converter c(html);
+    auto md = c.convert();
+
+    if (md != expectedMd) {
+      cout << "Failed to convert quoted '>': " << html << "\n"
+           << "Expected Markdown: " << expectedMd << "\n"
+           << "Generated Markdown: " << md << "\n";
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool testLineWrapping() {
+  testOption("lineWrapping");
+
+  html2md::Options options;
+  options.softBreak = 20;
+  options.hardBreak = 30;
+
+  vector<std::pair<string, string>> testCases = {
+      // Columns are counted, not bytes
+      {"<p>\u00e9\u00e9\u00e9\u00e9\u00e9 \u00e9\u00e9\u00e9\u00e9\u00e9 "
+       "\u00e9\u00e9\u00e9\u00e9\u00e9 \u00e9\u00e9\u00e9\u00e9\u00e9 "
+       "\u00e9\u00e9\u00e9\u00e9\u00e9</p>",
+       "\u00e9\u00e9\u00e9\u00e9\u00e9 \u00e9\u00e9\u00e9\u00e9\u00e9 "
+       "\u00e9\u00e9\u00e9\u00e9\u00e9 \u00e9\u00e9\u00e9\u00e9\u00e9\n"
+       "\u00e9\u00e9\u00e9\u00e9\u00e9\n"},
+      // Continuation lines are indented to the text of the list item
+      {"<ul><li>aaa bbb ccc ddd eee fff ggg</li></ul>",
+       "- aaa bbb ccc ddd eee\n  fff ggg\n"},
+      {"<blockquote>aaaa bbbb cccc dddd eeee ffff</blockquote>",
+       "> aaaa bbbb cccc dddd\n> eeee ffff\n"},
+      // Links aren't broken, a line never starts with a list marker
+      {"<p>aaaa bbbb cccc <a href=\"u\">dd ee ff gg</a> hh</p>",
+       "aaaa bbbb cccc\n[dd ee ff gg](u) hh\n"},
+      // A '[' without "](" isn't a link, hardBreak is kept even within one
+      {"<p>aaaa [bbbb cccc dddd eeee ffff gggg hhhh</p>",
+       "aaaa [bbbb cccc dddd\neeee ffff gggg hhhh\n"},
+      {"<p><a href=\"u\">aaaa bbbb cccc dddd eeee ffff gggg</a></p>",
+       "[aaaa bbbb cccc dddd eeee ffff\ngggg](u)\n"},
+      {"<p>aaaa bbbb cccc dddd 1. eeee</p>", "aaaa bbbb cccc dddd 1.\neeee\n"},
+      {"<pre><code>aaaa bbbb cccc dddd eeee ffff\n</code></pre>",
+       "```\naaaa bbbb cccc dddd eeee ffff\n```\n"}};
+
+  for (const auto &[html, expectedMd] : testCases) {
+    html2md::Converter c(html, &options);
+    auto md = c.convert();
+
+    if (md != expectedMd) {
+      cout << "Failed to wrap: " << html << "\n"
+           << "Expected Markdown: " << expectedMd << "\n"
+           << "Generated Markdown: " << md << "\n";
+      return false;
+    }
+  }
+
+  return true;
+}
+
 // Test self closing tags <a href=\"http://example1.com/\">First</a>  <br/> then <a href=\"http://example2.com\">second</a>
 bool testSelfClosingTags() {
   testOption("selfClosingTags");
@@ -439,6 +512,32 @@ bool testInvalidTags() {
   return true;
 }
 
+bool testMalformedTags() {
+  testOption("malformedTags");
+
+  // Closing tags in the wrong order or missing ones must not make the
+  // converter read outside of the Markdown
+  vector<string> testCases = {"<blockquote><table></blockquote></table>",
+                              "x<ol>"};
+
+  vector<string> expectedOutputs = {"", "x\n"};
+
+  for (size_t i = 0; i < testCases.size(); i++) {
+    html2md::Converter c(testCases[i]);
+    auto md = c.convert();
+
+    if (md != expectedOutputs[i]) {
+      cout << "Failed to handle malformed tags:\n"
+           << "Input: " << testCases[i] << "\n"
+           << "Expected: " << expectedOutputs[i] << "\n"
+           << "Got: " << md << "\n";
+      return false;
+    }
+  }
+
+  return true;
+}
+
 bool testEscapingNumberedList() {
   testOption("escapingNumberedList");
 
@@ -459,6 +558,100 @@ bool testEscapingNumberedList() {
   return true;
 }
 
+bool testCompressWhitespace() {
+  testOption("compressWhitespace");
+
+  html2md::Options options;
+  options.compressWhitespace = true;
+
+  string html = "<p>\n  one\ntwo \t three\r\n <b>four</b>\n</p>";
+
+  html2md::Converter c(html, &options);
+  auto md = c.convert();
+
+  string expected = "one two three **four**\n";
+
+  if (md != expected) {
+    cout << "Failed to compress whitespace:\n"
+         << "Input: " << html << "\n"
+         << "Expected: " << expected << "\n"
+         << "Got: " << md << "\n";
+    return false;
+  }
+
+  // Code keeps its whitespace, the same as without the option
+  string pre = "<pre><code>a\n  b\tc</code></pre>";
+  html2md::Options defaults;
+  html2md::Converter compressed(pre, &options);
+  html2md::Converter kept(pre, &defaults);
+  md = compressed.convert();
+
+  if (md != kept.convert() || md.find("a\n  b\tc") == string::npos) {
+    cout << "Whitespace in <pre> was compressed:\n"
+         << "Input: " << pre << "\n"
+         << "Got: " << md << "\n";
+    return false;
+  }
+
+  // The newlines of pretty-printed blockquotes keep their list items and
+  // paragraphs apart
+  const std::pair<string, string> blockquotes[] = {
+      {"<blockquote>\n<ul>\n<li>Item 1</li>\n<li>Item 2</li>\n</ul>\n"
+       "</blockquote>",
+       ">\n>\n> - Item 1\n> - Item 2\n>\n"},
+      {"<blockquote>\n<p>a</p>\n<p>b</p>\n</blockquote>",
+       ">\n> a\n>\n> b\n>\n"},
+  };
+
+  for (const auto &blockquote : blockquotes) {
+    html2md::Converter converter(blockquote.first, &options);
+    md = converter.convert();
+
+    if (md != blockquote.second) {
+      cout << "Failed to compress whitespace in a blockquote:\n"
+           << "Input: " << blockquote.first << "\n"
+           << "Expected: " << blockquote.second << "\n"
+           << "Got: " << md << "\n";
+      return false;
+    }
+  }
+  return true;
+}
+
+bool testEscapeMarkdown() {
+  testOption("escapeMarkdown");
+
+  html2md::Options options;
+  options.escapeMarkdown = true;
+
+  const std::pair<string, string> cases[] = {
+      {"<p>snake_case [link] a|b C# 1+1 a-b</p>",
+       "snake\\_case \\[link\\] a|b C# 1+1 a-b\n"},
+      {"<p>- item</p><p>&gt; quote &lt;b&gt;</p>",
+       "\\- item\n\n\\> quote \\<b>\n"},
+      {"<ul><li>+ nested</li></ul>", "- \\+ nested\n"},
+      {"<table><tr><th>a|b</th><th>c</th></tr>"
+       "<tr><td>x_y</td><td>-</td></tr></table>",
+       "| a\\|b | c |\n|------|---|\n| x\\_y | - |\n"},
+      {"<p><code>a_b [c] &lt;d&gt;</code></p>", "`a_b [c] <d>`\n"},
+  };
+
+  for (const auto &test : cases) {
+    html2md::Converter c(test.first, &options);
+    auto md = c.convert();
+
+    if (md != test.second) {
+      cout << "Failed to escape Markdown:\n"
+           << "Input: " << test.first << "\n"
+           << "Expected: " << test.second << "\n"
+           << "Got: " << md << "\n";
+      return false;
+    }
+  }
+
+  return true;
+}
+
 bool testTableFormatting() {
   testOption("tableFormatting");
 
@@ -576,6 +769,237 @@ bool testPreserveNbsp() {
   return true;
 }
 
+bool testOutputSizeEstimate() {
+  testOption("outputSizeEstimate");
+
+  // Mostly inline script: reserving a multiple of the input would be a waste
+  string scriptHeavy = "<html><head><script>" + string(100000, 'x') +
+                       "</script></head><body><p>Some text</p></body></html>";
+
+  html2md::ConversionStats stats;
+  html2md::Converter c(scriptHeavy);
+  auto md = c.convert(&stats);
+
+  if (stats.inputBytes != scriptHeavy.size() || stats.outputBytes != md.size() ||
+      stats.estimatedOutputBytes > scriptHeavy.size() / 10) {
+    cout << "Bad estimate for script heavy page: " << stats.estimatedOutputBytes
+         << " bytes for " << stats.inputBytes << " bytes of input\n";
+    return false;
+  }
+
+  // Text heavy: the estimate should cover the output
+  string textHeavy;
+  for (int i = 0; i < 1000; ++i)
+    textHeavy += "<p>Some *text* with `code` and <a href=\"x\">a link</a></p>";
+
+  html2md::Converter c2(textHeavy);
+  md = c2.convert(&stats);
+
+  if (stats.estimatedOutputBytes < stats.outputBytes) {
+    cout << "Estimate " << stats.estimatedOutputBytes
+         << " is smaller than the output " << stats.outputBytes << "\n";
+    return false;
+  }
+
+  return true;
+}
+
+bool testConversionStats() {
+  testOption("conversionStats");
+
+  string html = "<script>var x = 1;</script><p>a &amp; b</p>"
+                "<table><tr><th>A</th></tr><tr><td>1</td></tr></table>";
+
+  html2md::ConversionStats stats;
+  html2md::Converter c(html);
+  auto md = c.convert(&stats);
+
+  return md == html2md::Convert(html) && stats.tags["p"] == 1 &&
+         stats.tags["td"] == 1 && stats.ignoredBytes == 10 &&
+         stats.entitiesDecoded == 1 && stats.tablesFormatted == 1 &&
+         stats.tableCells == 2 && stats.totalNs >= stats.tokenizeNs;
+}
+
+bool testParallelCleanUp() {
+  testOption("parallelCleanUp");
+
+  // The HTML of all Markdown files in this dir, repeated until the Markdown is
+  // large enough to be cleaned up in parallel
+  string part;
+  for (const auto &p : fs::directory_iterator(DIR))
+    if (p.path().extension() == ".md")
+      part += markdown::toHTML(file::readAll(p.path().string()));
+
+  string html;
+  while (html.size() < 2 * 1024 * 1024)
+    html += part + "<pre><code>unclosed\n\n\n  code &amp;\n";
+
+  for (bool keepHtmlEntities : {false, true}) {
+    for (bool forceLeftTrim : {false, true}) {
+      html2md::Options options;
+      options.keepHtmlEntities = keepHtmlEntities;
+      options.forceLeftTrim = forceLeftTrim;
+      html2md::Converter serial(html, &options);
+      const string expected = serial.convert();
+
+      options.threads = 4;
+      html2md::Converter parallel(html, &options);
+      if (parallel.convert() != expected) {
+        cout << "Output differs with keepHtmlEntities=" << keepHtmlEntities
+             << " forceLeftTrim=" << forceLeftTrim << "\n";
+        return false;
+      }
+    }
+  }
+
+  return true;
+}
+
+bool testParallelConversion() {
+  testOption("parallelConversion");
+
+  // Every Markdown file in this dir, repeated until its HTML is large enough
+  // to be converted in parallel
+  for (const auto &p : fs::directory_iterator(DIR)) {
+    if (p.path().extension() != ".md")
+      continue;
+
+    const string part = markdown::toHTML(file::readAll(p.path().string()));
+    string html;
+    while (html.size() < 1024 * 1024)
+      html += part;
+
+    html2md::Options options;
+    html2md::Converter serial(html, &options);
+    const string expected = serial.convert();
+
+    options.threads = 4;
+    html2md::Converter parallel(html, &options);
+    if (parallel.convert() != expected || parallel.ok() != serial.ok()) {
+      cout << "Output of " << p.path().filename() << " differs\n";
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool testStreamingConversion() {
+  testOption("streamingConversion");
+
+  // Chunks of odd sizes end in the middle of tags, entities and text runs.
+  // What flush() returns in between and finish() make up the whole Markdown.
+  size_t flushed = 0;
+  for (const auto &p : fs::directory_iterator(DIR)) {
+    if (p.path().extension() != ".md")
+      continue;
+
+    const string html = markdown::toHTML(file::readAll(p.path().string()));
+
+    for (bool compressWhitespace : {false, true}) {
+      html2md::Options options;
+      options.compressWhitespace = compressWhitespace;
+
+      html2md::Converter whole(html, &options);
+      const string expected = whole.convert();
+
+      for (size_t chunk : {1, 7, 4096}) {
+        html2md::Converter streamed("", &options);
+        string md;
+        for (size_t i = 0; i < html.size(); i += chunk) {
+          streamed.feed(html.data() + i, std::min(chunk, html.size() - i));
+          md += streamed.flush();
+        }
+        flushed += !md.empty();
+
+        if (md + streamed.finish() != expected) {
+          cout << "Output of " << p.path().filename() << " fed in chunks of "
+               << chunk << " bytes differs\n";
+          return false;
+        }
+      }
+    }
+  }
+
+  if (flushed == 0) {
+    cout << "flush() never returned Markdown before finish()\n";
+    return false;
+  }
+
+  return true;
+}
+
+bool testCApi() {
+  testOption("cApi");
+
+  const string html = "<h1>Title</h1><p>Some <b>bold</b> text &amp; more</p>";
+  html2md::Converter converter(html);
+  const string expected = converter.convert();
+
+  bool passed = true;
+  auto check = [&](bool condition, const char *what) {
+    if (!condition) {
+      cout << "C API: " << what << "\n";
+      passed = false;
+    }
+  };
+
+  // A caller compiled with an older, smaller struct is rejected
+  html2md_options options;
+  options.struct_size = sizeof(size_t);
+  check(html2md_options_init(&options) == HTML2MD_INVALID_ARGUMENT &&
+            html2md_engine_new(&options) == nullptr,
+        "too small options accepted");
+
+  options.struct_size = sizeof(options);
+  check(html2md_options_init(&options) == HTML2MD_OK &&
+            options.struct_size == sizeof(options),
+        "options not initialized");
+  options.collect_stats = 1;
+  html2md_engine *engine = html2md_engine_new(&options);
+
+  // Too small a buffer keeps the Markdown, which can be borrowed
+  size_t needed = 0;
+  char small[4];
+  check(html2md_convert(engine, html.data(), html.size(), small, sizeof(small),
+                        &needed) == HTML2MD_BUFFER_TOO_SMALL,
+        "small buffer accepted");
+  check(needed == expected.size(), "wrong size needed");
+
+  const char *md = nullptr;
+  size_t size = 0;
+  html2md_output(engine, &md, &size);
+  check(string(md, size) == expected, "borrowed output differs");
+
+  html2md_stats stats;
+  stats.struct_size = sizeof(stats);
+  html2md_engine_stats(engine, &stats);
+  check(stats.input_bytes == html.size() && stats.tags == 3,
+        "wrong statistics");
+
+  vector<char> out(needed + 1);
+  check(html2md_convert(engine, html.data(), html.size(), out.data(),
+                        out.size(), &needed) == HTML2MD_OK &&
+            string(out.data()) == expected,
+        "output differs");
+
+  // Streaming, no other conversion can run before it is finished
+  for (size_t i = 0; i < html.size(); i += 5)
+    html2md_feed(engine, html.data() + i, std::min<size_t>(5, html.size() - i));
+  check(html2md_convert(engine, html.data(), html.size(), nullptr, 0,
+                        nullptr) == HTML2MD_INVALID_ARGUMENT,
+        "convert during a fed conversion accepted");
+  check(html2md_finish(engine, out.data(), out.size(), &needed) == HTML2MD_OK &&
+            string(out.data()) == expected,
+        "streamed output differs");
+  check(html2md_finish(engine, nullptr, 0, nullptr) ==
+            HTML2MD_INVALID_ARGUMENT,
+        "finish without feed accepted");
+
+  html2md_engine_free(engine);
+  return passed;
+}
+
 int main(int argc, const char **argv) {
   // List to store all markdown files in this dir
   vector<string> files;
@@ -635,11 +1059,22 @@ int main(int argc, const char **argv) {
                 &testSelfClosingUppercaseTags,
                 &testWhitespaceTags,
                 &testSelfClosingTags,
+                &testQuotedGreaterThan,
+                &testLineWrapping,
                 &testZeroWidthSpaceWithBlockquote,
                 &testInvalidTags,
+                &testMalformedTags,
                 &testEscapingNumberedList,
+                &testEscapeMarkdown,
+                &testCompressWhitespace,
                 &testTableFormatting,
                 &testPreserveNbsp,
+                &testOutputSizeEstimate,
+                &testConversionStats,
+                &testParallelCleanUp,
+                &testParallelConversion,
+                &testStreamingConversion,
+                &testCApi,
               };
 
   for (const auto &test : tests)
@@ -0,0 +1,207 @@
+// Micro benchmarks of the individual stages of the conversion, to see changes
+// to one stage that get lost in the noise of end-to-end benchmarks.
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "corpus.h"
+#include "internal.h"
+#include "table.h"
+
+using std::cerr;
+using std::cout;
+using std::string;
+using std::vector;
+using std::chrono::duration;
+using std::chrono::high_resolution_clock;
+
+namespace input {
+// Repeat `pattern` until the result has at least `size` bytes
+string repeat(const string &pattern, size_t size) {
+  string result;
+  result.reserve(size + pattern.size());
+  while (result.size() < size)
+    result += pattern;
+  return result;
+}
+
+// Raw Markdown as the tokenizer leaves it: untrimmed lines, runs of empty
+// lines, a code block, leftovers of the tag handlers
+string rawMarkdown(size_t size) {
+  return repeat("  Some **bold** text with a [link](https://example.com) , "
+                "and more words   \n\n\n\n"
+                "\t\tIndented line  \n"
+                "Line break at the end  \n"
+                "\n.\n"
+                "```cpp\n  int main() {   \n    return 0;\n  }\n```\n"
+                "- item\n- item\n\n",
+                size);
+}
+
+// Text with `percent` of its words being an entity
+string entityText(size_t size, int percent) {
+  static const char *entities[] = {"&amp;", "&lt;", "&gt;", "&quot;", "&nbsp;"};
+  string result;
+  result.reserve(size + 16);
+  for (int i = 0; result.size() < size; ++i) {
+    result += i % 100 < percent ? entities[i % 5] : "words";
+    result += (i % 12 == 11) ? '\n' : ' ';
+  }
+  return result;
+}
+
+// Paragraphs of `size` bytes on one line each, like the tokenizer produces
+// them, mixing ASCII, accented and CJK words with links and inline code
+string paragraphs(size_t size) {
+  static const char *words[] = {"the",   "quick", "brown", "fox",   "jumps",
+                                "über",  "café",  "日本語", "[link](u)", "`x`"};
+  string result;
+  result.reserve(size + 16);
+  for (int i = 0; result.size() < size; ++i) {
+    result += words[i * 7 % 10];
+    result += (i % 200 == 199) ? "\n\n" : " ";
+  }
+  return result;
+}
+
+// Unformatted table like the tokenizer produces it, with `size` bytes
+string table(size_t size) {
+  string result = "|Region|Q1|Q2|Total|\n|:-|-:|-:|:-:|\n";
+  for (int i = 0; result.size() < size; ++i)
+    result += "|region " + std::to_string(i) + "|" +
+              std::to_string(i * 37 % 1000) + "|" +
+              std::to_string(i * 91 % 100000) + "|" +
+              std::to_string(i % 7 == 0 ? 1234567 : 42) + "|\n";
+  return result;
+}
+
+// An opening tag of `size` bytes whose last attribute is the one searched for
+string tag(size_t size) {
+  string result = "<a";
+  for (int i = 0; result.size() + 40 < size; ++i)
+    result += " data-x" + std::to_string(i) + "=\"value\"";
+  result += " href=\"https://example.com/page\">";
+  return result;
+}
+} // namespace input
+
+struct Stage {
+  string name;
+  std::function<string(size_t)> makeInput;
+  // Run the stage on `work`, which is a fresh copy of the input
+  std::function<void(string &work)> run;
+};
+
+// Median time per byte of `stage` for an input of `size` bytes
+double measure(const Stage &stage, size_t size, double min_time_s) {
+  const string input = stage.makeInput(size);
+
+  string work;
+  work.reserve(input.size() * 2);
+
+  vector<double> times_ns;
+  double total_ns = 0.0;
+
+  // The first run warms up caches and is not counted
+  for (int i = -1; total_ns < min_time_s * 1e9 || times_ns.size() < 5; ++i) {
+    work.assign(input); // Not timed, reuses the capacity
+    auto start = high_resolution_clock::now();
+    stage.run(work);
+    auto end = high_resolution_clock::now();
+
+    if (i < 0)
+      continue;
+
+    double ns = duration<double, std::nano>(end - start).count();
+    times_ns.push_back(ns);
+    total_ns += ns;
+  }
+
+  std::sort(times_ns.begin(), times_ns.end());
+  return times_ns[times_ns.size() / 2] / input.size();
+}
+
+int main(int argc, char **argv) {
+  vector<size_t> sizes = {1024, 64 * 1024, 1024 * 1024};
+  double min_time_s = 0.2;
+
+  for (int i = 1; i < argc; ++i) {
+    string arg = argv[i];
+    if (arg == "--sizes" && i + 1 < argc) {
+      sizes.clear();
+      string list = argv[++i];
+      for (size_t pos = 0; pos < list.size();) {
+        size_t comma = std::min(list.find(',', pos), list.size());
+        sizes.push_back(corpus::parseSize(list.substr(pos, comma - pos)));
+        pos = comma + 1;
+      }
+    } else if (arg == "--min-time" && i + 1 < argc) {
+      min_time_s = std::atof(argv[++i]);
+    } else {
+      cerr << "Usage: " << argv[0] << " [--sizes 1K,64K,1M] [--min-time SEC]\n";
+      return 2;
+    }
+  }
+
+  static const std::unordered_map<string, string> entities = {
+      {"&quot;", "\""}, {"&lt;", "<"},   {"&gt;", ">"},
+      {"&amp;", "&"},   {"&nbsp;", " "}, {"&rarr;", "→"}};
+
+  const vector<Stage> stages = {
+      {"TidyAllLines", input::rawMarkdown,
+       [](string &md) { html2md::detail::TidyAllLines(&md, false); }},
+      {"DecodeEntities (0%)",
+       [](size_t size) { return input::entityText(size, 0); },
+       [](string &md) { html2md::detail::DecodeEntities(&md, entities); }},
+      {"DecodeEntities (10%)",
+       [](size_t size) { return input::entityText(size, 10); },
+       [](string &md) { html2md::detail::DecodeEntities(&md, entities); }},
+      {"ReplaceLeftovers", input::rawMarkdown,
+       [](string &md) { html2md::detail::ReplaceLeftovers(&md); }},
+      {"ReplaceAll (no match)", input::rawMarkdown,
+       [](string &md) { html2md::detail::ReplaceAll(&md, "\n#\n", "\n"); }},
+      {"ReplaceAll (same size)", input::rawMarkdown,
+       [](string &md) { html2md::detail::ReplaceAll(&md, "**", "__"); }},
+      {"ReplaceAll (shrinking)", input::rawMarkdown,
+       [](string &md) { html2md::detail::ReplaceAll(&md, "\n.\n", ".\n"); }},
+      {"CleanUpMarkdown", input::rawMarkdown,
+       [](string &md) {
+         html2md::detail::TidyAllLines(&md, false);
+         html2md::detail::DecodeEntities(&md, entities);
+         html2md::detail::ReplaceLeftovers(&md);
+       }},
+      {"WrapLines", input::paragraphs,
+       [](string &md) { html2md::detail::WrapLines(&md, 80, 100); }},
+      {"formatMarkdownTable", input::table,
+       [](string &md) { md = formatMarkdownTable(md); }},
+      {"ExtractAttribute", input::tag,
+       [](string &tag) {
+         auto value = html2md::detail::ExtractAttribute(tag.data(), tag.size(),
+                                                        "href");
+         tag.swap(value);
+       }},
+  };
+
+  cout << std::left << std::setw(26) << "Stage";
+  for (size_t size : sizes)
+    cout << std::right << std::setw(12) << corpus::formatSize(size);
+  cout << "  (ns/byte, median)\n" << string(26 + 12 * sizes.size(), '-') << "\n";
+
+  for (const auto &stage : stages) {
+    cout << std::left << std::setw(26) << stage.name << std::flush;
+    for (size_t size : sizes) {
+      double ns_per_byte = measure(stage, size, min_time_s);
+      cout << std::right << std::fixed << std::setprecision(3) << std::setw(12)
+           << ns_per_byte << std::flush;
+    }
+    cout << "\n";
+  }
+
+  return 0;
+}
@@ -0,0 +1,106 @@
+// Copyright (c) Tim Gromeyer
+// Licensed under the MIT License - https://opensource.org/licenses/MIT
+
+#include "perf_counters.h"
+
+#ifdef __linux__
+#include <cerrno>
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace perf {
+
+#ifdef __linux__
+namespace {
+int open(uint32_t type, uint64_t config) {
+  perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = type;
+  attr.config = config;
+  attr.disabled = 1;
+  // Counting user space only is allowed with perf_event_paranoid <= 2
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+
+  return static_cast<int>(
+      syscall(SYS_perf_event_open, &attr, 0 /* this thread */, -1, -1, 0));
+}
+
+uint64_t read(int fd) {
+  uint64_t value = 0;
+  if (fd < 0 || ::read(fd, &value, sizeof(value)) != sizeof(value))
+    return 0;
+  return value;
+}
+} // namespace
+
+CounterSet::CounterSet() {
+  fds_[kCycles] = open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+  int error = fds_[kCycles] < 0 ? errno : 0;
+  fds_[kInstructions] = open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+  fds_[kBranchMisses] = open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+  fds_[kCacheMisses] = open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+
+  if (!available())
+    error_ = std::string("perf_event_open failed: ") + strerror(error);
+}
+
+CounterSet::~CounterSet() {
+  for (int fd : fds_)
+    if (fd >= 0)
+      close(fd);
+}
+
+bool CounterSet::available() const {
+  for (int fd : fds_)
+    if (fd >= 0)
+      return true;
+  return false;
+}
+
+void CounterSet::start() {
+  for (int fd : fds_) {
+    if (fd >= 0) {
+      ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+      ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+  }
+}
+
+Counters CounterSet::stop() {
+  for (int fd : fds_)
+    if (fd >= 0)
+      ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+
+  Counters counters;
+  counters.cycles = read(fds_[kCycles]);
+  counters.instructions = read(fds_[kInstructions]);
+  counters.branchMisses = read(fds_[kBranchMisses]);
+  counters.cacheMisses = read(fds_[kCacheMisses]);
+  counters.hasCycles = fds_[kCycles] >= 0;
+  counters.hasInstructions = fds_[kInstructions] >= 0;
+  counters.hasBranchMisses = fds_[kBranchMisses] >= 0;
+  counters.hasCacheMisses = fds_[kCacheMisses] >= 0;
+  return counters;
+}
+#else
+CounterSet::CounterSet() : error_("Only supported on Linux") {
+  for (int &fd : fds_)
+    fd = -1;
+}
+
+CounterSet::~CounterSet() = default;
+
+bool CounterSet::available() const { return false; }
+
+void CounterSet::start() {}
+
+Counters CounterSet::stop() { return Counters(); }
+#endif
+
+} // namespace perf
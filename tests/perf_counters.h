@@ -0,0 +1,56 @@
+// Copyright (c) Tim Gromeyer
+// Licensed under the MIT License - https://opensource.org/licenses/MIT
+
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <cstdint>
+#include <string>
+
+// Hardware performance counters via perf_event_open(2), for the benchmarks.
+// Only available on Linux; elsewhere, or if the kernel denies access (see
+// /proc/sys/kernel/perf_event_paranoid), available() returns false and all
+// counters read as 0.
+namespace perf {
+
+struct Counters {
+  uint64_t cycles = 0;
+  uint64_t instructions = 0;
+  uint64_t branchMisses = 0;
+  uint64_t cacheMisses = 0; // Last level cache
+
+  // Which of the counters above could be opened
+  bool hasCycles = false;
+  bool hasInstructions = false;
+  bool hasBranchMisses = false;
+  bool hasCacheMisses = false;
+};
+
+// Counts the events of the calling thread between start() and stop()
+class CounterSet {
+public:
+  CounterSet();
+  ~CounterSet();
+
+  CounterSet(const CounterSet &) = delete;
+  CounterSet &operator=(const CounterSet &) = delete;
+
+  // true if at least one counter could be opened
+  bool available() const;
+
+  // Why no counter is available, empty if available() is true
+  const std::string &error() const { return error_; }
+
+  void start();
+  Counters stop();
+
+private:
+  enum { kCycles, kInstructions, kBranchMisses, kCacheMisses, kCount };
+
+  int fds_[kCount];
+  std::string error_;
+};
+
+} // namespace perf
+
+#endif // PERF_COUNTERS_H
@@ -0,0 +1,154 @@
+"""Measure the overhead of the Python bindings over the C++ library.
+
+Times pyhtml2md.convert() and Converter(...).convert(), with default and with
+custom Options, on generated documents of 100 B to 10 MB. The same documents
+are converted by the C++ benchmark (the benchmark-exe target, `benchmarks`)
+with --dir, and the share of the time spent in the bindings is reported:
+
+    overhead = (python - c++) / python
+
+Exits with 1 if the overhead of any call exceeds --max-overhead, so
+regressions in bindings.cpp are caught.
+
+    python tests/python/benchmark_bindings.py --benchmarks build/tests/benchmarks
+"""
+
+import argparse
+import json
+import os
+import shutil
+import statistics
+import subprocess
+import sys
+import tempfile
+import timeit
+
+import pyhtml2md
+
+from benchmark_threads import make_document
+
+# Options differing from the defaults, for Python and for --option of the
+# C++ benchmark
+CUSTOM_OPTIONS = {
+    "splitLines": False,
+    "escapeMarkdown": True,
+    "compressWhitespace": True,
+}
+
+SIZES = {"100": 100, "1K": 1000, "10K": 10000, "100K": 100000,
+         "1M": 1000000, "10M": 10000000}
+
+
+def parse_sizes(text):
+    sizes = []
+    for name in text.split(","):
+        if name not in SIZES:
+            raise argparse.ArgumentTypeError(
+                f"unknown size {name}, use any of {','.join(SIZES)}")
+        sizes.append(name)
+    return sizes
+
+
+def make_options(values):
+    options = pyhtml2md.Options()
+    for name, value in values.items():
+        setattr(options, name, value)
+    return options
+
+
+def median_ns(function, min_time):
+    """Median time of one call in nanoseconds, over at least min_time seconds."""
+    timer = timeit.Timer(function)
+    number, seconds = timer.autorange()
+    repeat = max(5, int(min_time / max(seconds, 1e-9)))
+    return statistics.median(timer.repeat(repeat=repeat, number=number)) / number * 1e9
+
+
+def find_benchmarks(path):
+    if path:
+        return path if os.path.isfile(path) else None
+
+    for candidate in ("build/tests/benchmarks", "build/benchmarks",
+                      "_build/tests/benchmarks"):
+        if os.path.isfile(candidate):
+            return candidate
+    return shutil.which("benchmarks")
+
+
+def run_cpp(benchmarks, directory, options, min_time):
+    """Median ns per document of the C++ benchmark, by file name."""
+    output = os.path.join(directory, "results.json")
+    command = [benchmarks, "--dir", directory, "--min-time", str(min_time),
+               "--top", "0", "--json", output]
+    for name, value in options.items():
+        command += ["--option", f"{name}={int(value) if isinstance(value, bool) else value}"]
+
+    subprocess.run(command, check=True, stdout=subprocess.DEVNULL)
+    with open(output) as f:
+        results = json.load(f)["results"]
+    return {os.path.basename(r["name"]): r["p50_ns"] for r in results}
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--sizes", type=parse_sizes, default=list(SIZES),
+                        help="comma separated sizes, any of " + ",".join(SIZES))
+    parser.add_argument("--min-time", type=float, default=0.5,
+                        help="seconds per measurement")
+    parser.add_argument("--benchmarks",
+                        help="path of the C++ benchmark executable")
+    parser.add_argument("--max-overhead", type=float,
+                        help="fail if the overhead exceeds PCT percent")
+    args = parser.parse_args()
+
+    documents = {size: make_document(0, SIZES[size]) for size in args.sizes}
+    options = make_options(CUSTOM_OPTIONS)
+    cases = [
+        ("convert()", "default",
+         lambda html: lambda: pyhtml2md.convert(html)),
+        ("Converter().convert()", "default",
+         lambda html: lambda: pyhtml2md.Converter(html).convert()),
+        ("Converter(options)", "custom",
+         lambda html: lambda: pyhtml2md.Converter(html, options).convert()),
+    ]
+
+    cpp = {}
+    benchmarks = find_benchmarks(args.benchmarks)
+    if benchmarks is None:
+        print("C++ benchmark not found, pass --benchmarks to compare\n")
+    else:
+        with tempfile.TemporaryDirectory() as directory:
+            for size, html in documents.items():
+                with open(os.path.join(directory, f"{size}.html"), "w",
+                          encoding="utf-8") as f:
+                    f.write(html)
+            cpp["default"] = run_cpp(benchmarks, directory, {}, args.min_time)
+            cpp["custom"] = run_cpp(benchmarks, directory, CUSTOM_OPTIONS,
+                                    args.min_time)
+
+    print(f"{'size':>6} {'call':<24} {'python (us)':>12} {'c++ (us)':>10} "
+          f"{'overhead (us)':>14} {'overhead':>9}")
+
+    worst = float("-inf")
+    for size, html in documents.items():
+        for name, options_name, make_call in cases:
+            python_ns = median_ns(make_call(html), args.min_time)
+            line = f"{size:>6} {name:<24} {python_ns / 1e3:>12.2f}"
+
+            cpp_ns = cpp.get(options_name, {}).get(f"{size}.html")
+            if cpp_ns is not None:
+                fraction = (python_ns - cpp_ns) / python_ns
+                worst = max(worst, fraction)
+                line += (f" {cpp_ns / 1e3:>10.2f} {(python_ns - cpp_ns) / 1e3:>14.2f}"
+                         f" {fraction * 100:>8.1f}%")
+            print(line)
+
+    if args.max_overhead is not None and cpp:
+        if worst * 100 > args.max_overhead:
+            print(f"\nOverhead of {worst * 100:.1f}% exceeds {args.max_overhead}%")
+            return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
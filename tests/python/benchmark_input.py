@@ -0,0 +1,58 @@
+"""Measure the per-call overhead of the input and output types of convert().
+
+Small documents make the cost of the Python boundary visible: str input is
+decoded and copied into a std::string, bytes-like input is read in place and
+as_bytes=True skips the UTF-8 decoding of the Markdown.
+
+    python tests/python/benchmark_input.py --sizes 100,1000,10000
+"""
+
+import argparse
+import timeit
+
+import pyhtml2md
+
+PARAGRAPH = "<p>Some <b>bold</b> text &amp; a <a href=\"/x\">link</a>.</p>\n"
+
+
+def make_html(size):
+    return (PARAGRAPH * (size // len(PARAGRAPH) + 1))[:size]
+
+
+def per_call_ns(function, min_time):
+    timer = timeit.Timer(function)
+    number, _ = timer.autorange()
+    number = max(number, int(number * min_time / 0.2))
+    return min(timer.repeat(repeat=5, number=number)) / number * 1e9
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--sizes", default="100,1000,10000",
+                        help="comma separated sizes of the HTML in bytes")
+    parser.add_argument("--min-time", type=float, default=0.2,
+                        help="seconds per measurement")
+    args = parser.parse_args()
+
+    print(f"{'size':>8} {'input':<24} {'ns/call':>10} {'vs str':>8}")
+    for size in (int(s) for s in args.sizes.split(",")):
+        html = make_html(size)
+        data = html.encode()
+        cases = [
+            ("str", lambda: pyhtml2md.convert(html)),
+            ("bytes", lambda: pyhtml2md.convert(data)),
+            ("bytes, as_bytes=True", lambda: pyhtml2md.convert(data, as_bytes=True)),
+            ("bytearray", lambda b=bytearray(data): pyhtml2md.convert(b)),
+            ("memoryview", lambda v=memoryview(data): pyhtml2md.convert(v)),
+        ]
+
+        baseline = None
+        for name, function in cases:
+            ns = per_call_ns(function, args.min_time)
+            baseline = baseline or ns
+            print(f"{size:>8} {name:<24} {ns:>10.0f} {ns / baseline:>7.2f}x")
+        print()
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,86 @@
+"""Measure how pyhtml2md scales over threads.
+
+Converts the same batch of documents serially, from a ThreadPoolExecutor
+calling convert() (which releases the GIL), and with convert_many() on 1, 2,
+4, ... native threads, and prints the speed-up over the serial loop.
+
+    python tests/python/benchmark_threads.py --docs 2000 --size 20000
+"""
+
+import argparse
+import os
+import time
+from concurrent.futures import ThreadPoolExecutor
+
+import pyhtml2md
+
+PARAGRAPH = ("<p>Some <b>bold</b> and <i>italic</i> text with a "
+             "<a href=\"https://example.com\">link</a> &amp; an entity.</p>\n")
+LIST = "<ul><li>One</li><li>Two <code>code</code></li><li>Three</li></ul>\n"
+TABLE = ("<table><tr><th>Name</th><th>Value</th></tr>"
+         "<tr><td>a</td><td>1</td></tr><tr><td>b</td><td>2</td></tr></table>\n")
+
+
+def make_document(index, size):
+    parts = [f"<h1>Document {index}</h1>\n"]
+    length = len(parts[0])
+    while length < size:
+        for part in (PARAGRAPH, PARAGRAPH, LIST, TABLE):
+            parts.append(part)
+            length += len(part)
+    return "".join(parts)
+
+
+def best_of(repeat, function):
+    best = float("inf")
+    for _ in range(repeat):
+        start = time.perf_counter()
+        function()
+        best = min(best, time.perf_counter() - start)
+    return best
+
+
+def thread_counts(maximum):
+    counts = []
+    n = 1
+    while n < maximum:
+        counts.append(n)
+        n *= 2
+    counts.append(maximum)
+    return counts
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--docs", type=int, default=1000)
+    parser.add_argument("--size", type=int, default=10000,
+                        help="bytes of HTML per document")
+    parser.add_argument("--threads", type=int, default=os.cpu_count() or 1)
+    parser.add_argument("--repeat", type=int, default=3)
+    args = parser.parse_args()
+
+    htmls = [make_document(i, args.size) for i in range(args.docs)]
+    megabytes = sum(len(html) for html in htmls) / 1e6
+
+    def report(name, seconds):
+        print(f"{name:<28} {seconds * 1e3:10.1f} ms {megabytes / seconds:9.1f} MB/s "
+              f"{serial / seconds:6.2f}x")
+
+    serial = best_of(args.repeat, lambda: [pyhtml2md.convert(html) for html in htmls])
+    print(f"{args.docs} documents, {megabytes:.1f} MB, {os.cpu_count()} cores\n")
+    report("serial convert()", serial)
+
+    for threads in thread_counts(args.threads):
+        with ThreadPoolExecutor(threads) as pool:
+            seconds = best_of(args.repeat,
+                              lambda: list(pool.map(pyhtml2md.convert, htmls)))
+        report(f"ThreadPoolExecutor({threads})", seconds)
+
+    for threads in thread_counts(args.threads):
+        seconds = best_of(args.repeat,
+                          lambda: pyhtml2md.convert_many(htmls, threads=threads))
+        report(f"convert_many(threads={threads})", seconds)
+
+
+if __name__ == "__main__":
+    main()
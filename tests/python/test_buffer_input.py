@@ -0,0 +1,49 @@
+import mmap
+
+import pytest
+import pyhtml2md
+
+HTML = "<h1>Hello</h1><p>Some <b>bold</b> text &amp; ümläute</p>"
+
+def test_bytes_like_input():
+    expected = pyhtml2md.convert(HTML)
+    data = HTML.encode()
+
+    assert pyhtml2md.convert(data) == expected
+    assert pyhtml2md.convert(bytearray(data)) == expected
+    assert pyhtml2md.convert(memoryview(data)) == expected
+    assert pyhtml2md.convert(memoryview(b"xx" + data)[2:]) == expected
+
+    with mmap.mmap(-1, len(data)) as m:
+        m.write(data)
+        assert pyhtml2md.convert(m) == expected
+
+def test_bytes_output():
+    expected = pyhtml2md.convert(HTML)
+    data = HTML.encode()
+
+    assert pyhtml2md.convert(data, as_bytes=True) == expected.encode()
+    assert pyhtml2md.convert(b"", as_bytes=True) == b""
+
+def test_bytes_options():
+    options = pyhtml2md.Options()
+    options.escapeMarkdown = True
+    html = "<p>a_b [c]</p>"
+    expected = pyhtml2md.Converter(html, options).convert()
+
+    assert pyhtml2md.convert(html.encode(), options) == expected
+    assert pyhtml2md.Converter(html.encode(), options).convert() == expected
+
+def test_invalid_utf8():
+    data = b"<p>caf\xe9</p>"
+
+    assert pyhtml2md.convert(data, as_bytes=True) == b"caf\xe9\n"
+    with pytest.raises(UnicodeDecodeError):
+        pyhtml2md.convert(data)
+
+def test_non_contiguous():
+    with pytest.raises(BufferError):
+        pyhtml2md.convert(memoryview(HTML.encode())[::2])
+
+if __name__ == "__main__":
+    pytest.main([__file__])
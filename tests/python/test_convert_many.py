@@ -0,0 +1,69 @@
+import threading
+
+import pytest
+import pyhtml2md
+
+def make_documents(count):
+    return [f"<h1>Document {i}</h1><p>Some <b>bold</b> text &amp; a <a href=\"/{i}\">link</a></p>"
+            for i in range(count)]
+
+def test_convert_many():
+    htmls = make_documents(50)
+    expected = [pyhtml2md.convert(html) for html in htmls]
+
+    assert pyhtml2md.convert_many(htmls) == expected
+    assert pyhtml2md.convert_many(htmls, threads=1) == expected
+    assert pyhtml2md.convert_many(htmls, threads=4) == expected
+    assert pyhtml2md.convert_many(htmls, threads=100) == expected
+    assert pyhtml2md.convert_many([]) == []
+
+def test_convert_many_options():
+    htmls = make_documents(10)
+    options = pyhtml2md.Options()
+    options.escapeMarkdown = True
+    expected = [pyhtml2md.Converter(html, options).convert() for html in htmls]
+
+    assert pyhtml2md.convert_many(htmls, options, threads=3) == expected
+
+def test_convert_from_threads():
+    # The GIL is released during the conversion, so this must not deadlock
+    htmls = make_documents(20)
+    expected = [pyhtml2md.convert(html) for html in htmls]
+    results = [None] * len(htmls)
+
+    def work(i):
+        results[i] = pyhtml2md.Converter(htmls[i]).convert()
+
+    threads = [threading.Thread(target=work, args=(i,)) for i in range(len(htmls))]
+    for t in threads:
+        t.start()
+    for t in threads:
+        t.join()
+
+    assert results == expected
+
+def test_shared_converter():
+    # A Converter used by another thread raises instead of racing
+    html = "".join(make_documents(2000))
+    expected = pyhtml2md.convert(html)
+    converter = pyhtml2md.Converter(html)
+    results = []
+
+    def work():
+        try:
+            results.append(converter.convert())
+        except RuntimeError:
+            results.append(None)
+
+    threads = [threading.Thread(target=work) for _ in range(8)]
+    for t in threads:
+        t.start()
+    for t in threads:
+        t.join()
+
+    assert len(results) == 8
+    assert all(md is None or md == expected for md in results)
+    assert converter.convert() == expected
+
+if __name__ == "__main__":
+    pytest.main([__file__])
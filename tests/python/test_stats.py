@@ -0,0 +1,20 @@
+import pytest
+import pyhtml2md
+
+def test_convert_with_stats():
+    html = "<script>var x = 1;</script><p>a &amp; b</p><table><tr><th>A</th></tr><tr><td>1</td></tr></table>"
+    converter = pyhtml2md.Converter(html)
+    markdown, stats = converter.convert_with_stats()
+
+    assert markdown == pyhtml2md.convert(html)
+    assert stats["input_bytes"] == len(html)
+    assert stats["output_bytes"] == len(markdown.encode())
+    assert stats["tags"]["p"] == 1
+    assert stats["ignored_bytes"] == len("var x = 1;")
+    assert stats["entities_decoded"] == 1
+    assert stats["tables_formatted"] == 1
+    assert stats["table_cells"] == 2
+    assert stats["total_ns"] >= stats["tokenize_ns"]
+
+if __name__ == "__main__":
+    pytest.main([__file__])
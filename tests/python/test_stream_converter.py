@@ -0,0 +1,60 @@
+import pytest
+import pyhtml2md
+
+HTML = ("<h1>Title</h1><p>Some <b>bold</b> text &amp; ümläute</p>"
+        "<table><tr><th>A</th><th>B</th></tr><tr><td>1</td><td>2</td></tr></table>")
+
+def chunks(data, size):
+    return [data[i:i + size] for i in range(0, len(data), size)]
+
+def test_stream_converter():
+    expected = pyhtml2md.convert(HTML)
+
+    for size in (1, 3, 16, len(HTML)):
+        converter = pyhtml2md.StreamConverter()
+        markdown = "".join(converter.feed(chunk)
+                           for chunk in chunks(HTML.encode(), size))
+        assert markdown + converter.close() == expected
+
+def test_stream_converter_incremental():
+    html = "".join("<p>Paragraph %d of the document</p>" % i for i in range(20))
+    expected = pyhtml2md.convert(html)
+
+    converter = pyhtml2md.StreamConverter()
+    parts = [converter.feed(chunk) for chunk in chunks(html, 64)]
+    assert any(parts[:-1])
+    assert "".join(parts) + converter.close() == expected
+
+    converter = pyhtml2md.StreamConverter()
+    parts = [converter.feed(chunk, as_bytes=True)
+             for chunk in chunks(html.encode(), 64)]
+    assert b"".join(parts) + converter.close(as_bytes=True) == \
+        expected.encode()
+
+def test_stream_converter_str_chunks():
+    converter = pyhtml2md.StreamConverter()
+    markdown = "".join(converter.feed(chunk) for chunk in chunks(HTML, 5))
+    assert markdown + converter.close() == pyhtml2md.convert(HTML)
+
+def test_stream_converter_options():
+    options = pyhtml2md.Options()
+    options.escapeMarkdown = True
+    html = "<p>a_b [c]</p>"
+
+    converter = pyhtml2md.StreamConverter(options)
+    markdown = converter.feed(memoryview(html.encode()), as_bytes=True)
+    assert markdown + converter.close(as_bytes=True) == \
+        pyhtml2md.Converter(html, options).convert().encode()
+
+def test_stream_converter_closed():
+    converter = pyhtml2md.StreamConverter()
+    converter.feed(b"<p>a</p>")
+    converter.close()
+
+    with pytest.raises(RuntimeError):
+        converter.feed(b"<p>b</p>")
+    with pytest.raises(RuntimeError):
+        converter.close()
+
+if __name__ == "__main__":
+    pytest.main([__file__])